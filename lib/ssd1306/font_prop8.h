@@ -0,0 +1,158 @@
+/*
+ * font_prop8.h
+ *
+ * Generated by tools/gen_prop_font.py from font8x8_basic_tr, do not edit.
+ */
+
+#ifndef MAIN_FONT_PROP8_H_
+#define MAIN_FONT_PROP8_H_
+
+/*
+   Proportional 8 pixel font for U+0020 - U+007E.
+   font_prop8_bitmap holds the glyph columns back to back (bit 0 = top row),
+   glyph n spans columns font_prop8_offsets[n] .. font_prop8_offsets[n+1]-1.
+   font_prop8_kern_pairs lists (left << 8 | right) pairs, sorted, that are
+   moved closer by font_prop8_kern_adjust columns.
+*/
+
+#define FONT_PROP8_FIRST 0x20
+#define FONT_PROP8_COUNT 95
+#define FONT_PROP8_KERN_COUNT 108
+
+static const uint8_t font_prop8_bitmap[] = {
+    0x00, 0x00, 0x00,   // U+0020 ( )
+    0x06, 0x5F, 0x5F, 0x06,   // U+0021 (!)
+    0x03, 0x03, 0x00, 0x03, 0x03,   // U+0022 (")
+    0x14, 0x7F, 0x7F, 0x14, 0x7F, 0x7F, 0x14,   // U+0023 (#)
+    0x24, 0x2E, 0x6B, 0x6B, 0x3A, 0x12,   // U+0024 ($)
+    0x46, 0x66, 0x30, 0x18, 0x0C, 0x66, 0x62,   // U+0025 (%)
+    0x30, 0x7A, 0x4F, 0x5D, 0x37, 0x7A, 0x48,   // U+0026 (&)
+    0x04, 0x07, 0x03,   // U+0027 (')
+    0x1C, 0x3E, 0x63, 0x41,   // U+0028 (()
+    0x41, 0x63, 0x3E, 0x1C,   // U+0029 ())
+    0x08, 0x2A, 0x3E, 0x1C, 0x1C, 0x3E, 0x2A, 0x08,   // U+002A (*)
+    0x08, 0x08, 0x3E, 0x3E, 0x08, 0x08,   // U+002B (+)
+    0x80, 0xE0, 0x60,   // U+002C (,)
+    0x08, 0x08, 0x08, 0x08, 0x08, 0x08,   // U+002D (-)
+    0x60, 0x60,   // U+002E (.)
+    0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01,   // U+002F (/)
+    0x3E, 0x7F, 0x71, 0x59, 0x4D, 0x7F, 0x3E,   // U+0030 (0)
+    0x40, 0x42, 0x7F, 0x7F, 0x40, 0x40,   // U+0031 (1)
+    0x62, 0x73, 0x59, 0x49, 0x6F, 0x66,   // U+0032 (2)
+    0x22, 0x63, 0x49, 0x49, 0x7F, 0x36,   // U+0033 (3)
+    0x18, 0x1C, 0x16, 0x53, 0x7F, 0x7F, 0x50,   // U+0034 (4)
+    0x27, 0x67, 0x45, 0x45, 0x7D, 0x39,   // U+0035 (5)
+    0x3C, 0x7E, 0x4B, 0x49, 0x79, 0x30,   // U+0036 (6)
+    0x03, 0x03, 0x71, 0x79, 0x0F, 0x07,   // U+0037 (7)
+    0x36, 0x7F, 0x49, 0x49, 0x7F, 0x36,   // U+0038 (8)
+    0x06, 0x4F, 0x49, 0x69, 0x3F, 0x1E,   // U+0039 (9)
+    0x66, 0x66,   // U+003A (:)
+    0x80, 0xE6, 0x66,   // U+003B (;)
+    0x08, 0x1C, 0x36, 0x63, 0x41,   // U+003C (<)
+    0x24, 0x24, 0x24, 0x24, 0x24, 0x24,   // U+003D (=)
+    0x41, 0x63, 0x36, 0x1C, 0x08,   // U+003E (>)
+    0x02, 0x03, 0x51, 0x59, 0x0F, 0x06,   // U+003F (?)
+    0x3E, 0x7F, 0x41, 0x5D, 0x5D, 0x1F, 0x1E,   // U+0040 (@)
+    0x7C, 0x7E, 0x13, 0x13, 0x7E, 0x7C,   // U+0041 (A)
+    0x41, 0x7F, 0x7F, 0x49, 0x49, 0x7F, 0x36,   // U+0042 (B)
+    0x1C, 0x3E, 0x63, 0x41, 0x41, 0x63, 0x22,   // U+0043 (C)
+    0x41, 0x7F, 0x7F, 0x41, 0x63, 0x3E, 0x1C,   // U+0044 (D)
+    0x41, 0x7F, 0x7F, 0x49, 0x5D, 0x41, 0x63,   // U+0045 (E)
+    0x41, 0x7F, 0x7F, 0x49, 0x1D, 0x01, 0x03,   // U+0046 (F)
+    0x1C, 0x3E, 0x63, 0x41, 0x51, 0x73, 0x72,   // U+0047 (G)
+    0x7F, 0x7F, 0x08, 0x08, 0x7F, 0x7F,   // U+0048 (H)
+    0x41, 0x7F, 0x7F, 0x41,   // U+0049 (I)
+    0x30, 0x70, 0x40, 0x41, 0x7F, 0x3F, 0x01,   // U+004A (J)
+    0x41, 0x7F, 0x7F, 0x08, 0x1C, 0x77, 0x63,   // U+004B (K)
+    0x41, 0x7F, 0x7F, 0x41, 0x40, 0x60, 0x70,   // U+004C (L)
+    0x7F, 0x7F, 0x0E, 0x1C, 0x0E, 0x7F, 0x7F,   // U+004D (M)
+    0x7F, 0x7F, 0x06, 0x0C, 0x18, 0x7F, 0x7F,   // U+004E (N)
+    0x1C, 0x3E, 0x63, 0x41, 0x63, 0x3E, 0x1C,   // U+004F (O)
+    0x41, 0x7F, 0x7F, 0x49, 0x09, 0x0F, 0x06,   // U+0050 (P)
+    0x1E, 0x3F, 0x21, 0x71, 0x7F, 0x5E,   // U+0051 (Q)
+    0x41, 0x7F, 0x7F, 0x09, 0x19, 0x7F, 0x66,   // U+0052 (R)
+    0x26, 0x6F, 0x4D, 0x59, 0x73, 0x32,   // U+0053 (S)
+    0x03, 0x41, 0x7F, 0x7F, 0x41, 0x03,   // U+0054 (T)
+    0x7F, 0x7F, 0x40, 0x40, 0x7F, 0x7F,   // U+0055 (U)
+    0x1F, 0x3F, 0x60, 0x60, 0x3F, 0x1F,   // U+0056 (V)
+    0x7F, 0x7F, 0x30, 0x18, 0x30, 0x7F, 0x7F,   // U+0057 (W)
+    0x43, 0x67, 0x3C, 0x18, 0x3C, 0x67, 0x43,   // U+0058 (X)
+    0x07, 0x4F, 0x78, 0x78, 0x4F, 0x07,   // U+0059 (Y)
+    0x47, 0x63, 0x71, 0x59, 0x4D, 0x67, 0x73,   // U+005A (Z)
+    0x7F, 0x7F, 0x41, 0x41,   // U+005B ([)
+    0x01, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60,   // U+005C (\)
+    0x41, 0x41, 0x7F, 0x7F,   // U+005D (])
+    0x08, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x08,   // U+005E (^)
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,   // U+005F (_)
+    0x03, 0x07, 0x04,   // U+0060 (`)
+    0x20, 0x74, 0x54, 0x54, 0x3C, 0x78, 0x40,   // U+0061 (a)
+    0x41, 0x7F, 0x3F, 0x48, 0x48, 0x78, 0x30,   // U+0062 (b)
+    0x38, 0x7C, 0x44, 0x44, 0x6C, 0x28,   // U+0063 (c)
+    0x30, 0x78, 0x48, 0x49, 0x3F, 0x7F, 0x40,   // U+0064 (d)
+    0x38, 0x7C, 0x54, 0x54, 0x5C, 0x18,   // U+0065 (e)
+    0x48, 0x7E, 0x7F, 0x49, 0x03, 0x02,   // U+0066 (f)
+    0x98, 0xBC, 0xA4, 0xA4, 0xF8, 0x7C, 0x04,   // U+0067 (g)
+    0x41, 0x7F, 0x7F, 0x08, 0x04, 0x7C, 0x78,   // U+0068 (h)
+    0x44, 0x7D, 0x7D, 0x40,   // U+0069 (i)
+    0x60, 0xE0, 0x80, 0x80, 0xFD, 0x7D,   // U+006A (j)
+    0x41, 0x7F, 0x7F, 0x10, 0x38, 0x6C, 0x44,   // U+006B (k)
+    0x41, 0x7F, 0x7F, 0x40,   // U+006C (l)
+    0x7C, 0x7C, 0x18, 0x38, 0x1C, 0x7C, 0x78,   // U+006D (m)
+    0x7C, 0x7C, 0x04, 0x04, 0x7C, 0x78,   // U+006E (n)
+    0x38, 0x7C, 0x44, 0x44, 0x7C, 0x38,   // U+006F (o)
+    0x84, 0xFC, 0xF8, 0xA4, 0x24, 0x3C, 0x18,   // U+0070 (p)
+    0x18, 0x3C, 0x24, 0xA4, 0xF8, 0xFC, 0x84,   // U+0071 (q)
+    0x44, 0x7C, 0x78, 0x4C, 0x04, 0x1C, 0x18,   // U+0072 (r)
+    0x48, 0x5C, 0x54, 0x54, 0x74, 0x24,   // U+0073 (s)
+    0x04, 0x3E, 0x7F, 0x44, 0x24,   // U+0074 (t)
+    0x3C, 0x7C, 0x40, 0x40, 0x3C, 0x7C, 0x40,   // U+0075 (u)
+    0x1C, 0x3C, 0x60, 0x60, 0x3C, 0x1C,   // U+0076 (v)
+    0x3C, 0x7C, 0x70, 0x38, 0x70, 0x7C, 0x3C,   // U+0077 (w)
+    0x44, 0x6C, 0x38, 0x10, 0x38, 0x6C, 0x44,   // U+0078 (x)
+    0x9C, 0xBC, 0xA0, 0xA0, 0xFC, 0x7C,   // U+0079 (y)
+    0x4C, 0x64, 0x74, 0x5C, 0x4C, 0x64,   // U+007A (z)
+    0x08, 0x08, 0x3E, 0x77, 0x41, 0x41,   // U+007B ({)
+    0x77, 0x77,   // U+007C (|)
+    0x41, 0x41, 0x77, 0x3E, 0x08, 0x08,   // U+007D (})
+    0x02, 0x03, 0x01, 0x03, 0x02, 0x03, 0x01,   // U+007E (~)
+};
+
+static const uint16_t font_prop8_offsets[96] = {
+    0, 3, 7, 12, 19, 25, 32, 39, 42, 46, 50, 58,
+    64, 67, 73, 75, 82, 89, 95, 101, 107, 114, 120, 126,
+    132, 138, 144, 146, 149, 154, 160, 165, 171, 178, 184, 191,
+    198, 205, 212, 219, 226, 232, 236, 243, 250, 257, 264, 271,
+    278, 285, 291, 298, 304, 310, 316, 322, 329, 336, 342, 349,
+    353, 360, 364, 371, 379, 382, 389, 396, 402, 409, 415, 421,
+    428, 435, 439, 445, 452, 456, 463, 469, 475, 482, 489, 496,
+    502, 507, 514, 520, 527, 534, 540, 546, 552, 554, 560, 567,
+};
+
+static const uint16_t font_prop8_kern_pairs[108] = {
+    0x222C, 0x222E, 0x222F, 0x224A, 0x225F, 0x226A, 0x272C, 0x272E,
+    0x275F, 0x276A, 0x2B5D, 0x2B5F, 0x2B7D, 0x2C22, 0x2C27, 0x2C37,
+    0x2C3F, 0x2C5C, 0x2C60, 0x2C7E, 0x2D5D, 0x2D5F, 0x2D7D, 0x2E22,
+    0x2E27, 0x2E37, 0x2E3F, 0x2E5C, 0x2E60, 0x2E7E, 0x2F2C, 0x2F2E,
+    0x2F2F, 0x2F4A, 0x2F5F, 0x2F6A, 0x3122, 0x3127, 0x312B, 0x312D,
+    0x3137, 0x313F, 0x315C, 0x315E, 0x3160, 0x317B, 0x317E, 0x375F,
+    0x3E5F, 0x3F5F, 0x405F, 0x462C, 0x462E, 0x462F, 0x464A, 0x465F,
+    0x466A, 0x4C22, 0x4C37, 0x4C3F, 0x4C5C, 0x4C7E, 0x505F, 0x5B2B,
+    0x5B2D, 0x5B7B, 0x5C22, 0x5C37, 0x5C3F, 0x5C5C, 0x5C7E, 0x5E5F,
+    0x5F22, 0x5F27, 0x5F2B, 0x5F2D, 0x5F34, 0x5F37, 0x5F3C, 0x5F3F,
+    0x5F5C, 0x5F5E, 0x5F60, 0x5F7B, 0x5F7E, 0x602C, 0x602E, 0x605F,
+    0x606A, 0x662C, 0x662E, 0x662F, 0x664A, 0x665F, 0x666A, 0x725F,
+    0x7B2B, 0x7B2D, 0x7B7B, 0x7D5D, 0x7D5F, 0x7D7D, 0x7E2C, 0x7E2E,
+    0x7E2F, 0x7E4A, 0x7E5F, 0x7E6A,
+};
+
+static const int8_t font_prop8_kern_adjust[108] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+#endif /* MAIN_FONT_PROP8_H_ */
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
@@ -6,6 +7,8 @@
 
 #include "ssd1306.h"
 #include "font8x8_basic.h"
+#include "font8x8_scaled.h"
+#include "font_prop8.h"
 
 // Include the New Driver Header if on ESP-IDF v5.2+
 #if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
@@ -14,18 +17,76 @@
 
 #define TAG "SSD1306"
 
-#define PACK8 __attribute__((aligned( __alignof__( uint8_t ) ), packed ))
-
-typedef union out_column_t {
-    uint32_t u32;
-    uint8_t  u8[4];
-} PACK8 out_column_t;
+// Without multi-buffer transmit, i2c_display_buffer() writes the span
+// header over the bytes in front of the span (_hdr for seg 0), so _hdr
+// has to precede _segs.
+_Static_assert(offsetof(PAGE_t, _segs) == offsetof(PAGE_t, _hdr) + SSD1306_SPAN_HEADER, "_hdr must precede _segs");
 
 // Forward declaration if i2c.c is removed
 void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void i2c_display_buffer(SSD1306_t * dev, int page, int seg, int width);
 void i2c_contrast(SSD1306_t * dev, int contrast);
+void i2c_write_commands(SSD1306_t * dev, const uint8_t * commands, int len);
 void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 
+// Send _segs[seg .. seg+width-1] of the internal buffer to the panel.
+static void ssd1306_send_segs(SSD1306_t * dev, int page, int seg, int width)
+{
+    if (dev->_address == SPI_ADDRESS) {
+        spi_display_image(dev, page, seg, &dev->_page[page]._segs[seg], width);
+    } else {
+        i2c_display_buffer(dev, page, seg, width);
+    }
+}
+
+// Called after a primitive has updated the internal buffer.
+// Immediate mode sends the changed segs right away, deferred mode only
+// widens the dirty span of the page so ssd1306_commit() can send it later.
+static void ssd1306_flush_segs(SSD1306_t * dev, int page, int seg, int width)
+{
+    if (width <= 0) return;
+    if (!dev->_deferred) {
+        ssd1306_send_segs(dev, page, seg, width);
+        return;
+    }
+    PAGE_t * _page = &dev->_page[page];
+    if (_page->_dirtyEnd > _page->_dirtyStart) {
+        if (seg < _page->_dirtyStart) _page->_dirtyStart = seg;
+        if (seg + width > _page->_dirtyEnd) _page->_dirtyEnd = seg + width;
+    } else {
+        _page->_dirtyStart = seg;
+        _page->_dirtyEnd = seg + width;
+    }
+}
+
+// Send a short sequence of command bytes (16 at most) in one transfer
+void ssd1306_write_commands(SSD1306_t * dev, const uint8_t * commands, int len)
+{
+    if (dev->_address == SPI_ADDRESS) {
+        spi_master_write_commands(dev, commands, len);
+    } else {
+        i2c_write_commands(dev, commands, len);
+    }
+}
+
+// Animations have to reach the panel at every step, even in deferred mode.
+static void ssd1306_animate_step(SSD1306_t * dev)
+{
+    if (dev->_deferred) ssd1306_commit(dev);
+}
+
+// Animation step followed by a command that acts on the panel RAM, such
+// as a scroll: the flush task has to have written the frame before the
+// command goes out on the bus
+static void ssd1306_animate_sync(SSD1306_t * dev)
+{
+    if (dev->_present_wait) {
+        dev->_present_wait(dev);
+        return;
+    }
+    ssd1306_animate_step(dev);
+}
+
 void ssd1306_init(SSD1306_t * dev, int width, int height)
 {
     dev->_width = width;
@@ -42,10 +103,29 @@ void ssd1306_init(SSD1306_t * dev, int width, int height)
         i2c_init(dev, width, height);
 #endif
     }
-    // Initialize internal buffer
+    // Initialize internal buffer, clean and in immediate mode
     for (int i=0;i<dev->_pages;i++) {
         memset(dev->_page[i]._segs, 0, 128);
+        dev->_page[i]._dirtyStart = dev->_page[i]._dirtyEnd = 0;
     }
+    dev->_deferred = false;
+    dev->_present = NULL;
+    dev->_present_wait = NULL;
+
+    // Drive levels the fades start from and go back to. The bus init
+    // sequences differ (the app's own one sends none of these), so set
+    // them here.
+    dev->_precharge = SSD1306_PRECHARGE_INIT;
+    dev->_vcomh = SSD1306_VCOMH_INIT;
+    uint8_t levels[] = {
+        OLED_CMD_SET_CONTRAST, 0xFF,                    // 81
+        OLED_CMD_SET_PRECHARGE, dev->_precharge,        // D9
+        OLED_CMD_SET_VCOMH_DESELCT, dev->_vcomh,        // DB
+    };
+    ssd1306_write_commands(dev, levels, sizeof(levels));
+    memset(&dev->_fade, 0, sizeof(dev->_fade));
+    dev->_fade._level = 255;
+    dev->_fade._restore = 255;
 }
 
 int ssd1306_get_width(SSD1306_t * dev)
@@ -65,15 +145,67 @@ int ssd1306_get_pages(SSD1306_t * dev)
 
 void ssd1306_show_buffer(SSD1306_t * dev)
 {
-    if (dev->_address == SPI_ADDRESS) {
-        for (int page=0; page<dev->_pages;page++) {
-            spi_display_image(dev, page, 0, dev->_page[page]._segs, dev->_width);
-        }
-    } else {
-        for (int page=0; page<dev->_pages;page++) {
-            i2c_display_image(dev, page, 0, dev->_page[page]._segs, dev->_width);
-        }
+    if (dev->_present) {
+        dev->_present(dev);
+        return;
     }
+    for (int page=0; page<dev->_pages;page++) {
+        ssd1306_send_segs(dev, page, 0, dev->_width);
+        dev->_page[page]._dirtyStart = dev->_page[page]._dirtyEnd = 0;
+    }
+}
+
+void ssd1306_set_deferred(SSD1306_t * dev, bool deferred)
+{
+    // The flush task needs the back buffer to stay deferred
+    if (dev->_present) return;
+    // Leaving deferred mode must not lose what was drawn so far
+    if (dev->_deferred && !deferred) ssd1306_commit(dev);
+    dev->_deferred = deferred;
+}
+
+void ssd1306_commit(SSD1306_t * dev)
+{
+    // With the flush task running, the panel is only written from its
+    // front buffer, or its diffs would miss what was sent around it
+    if (dev->_present) {
+        dev->_present(dev);
+        return;
+    }
+    for (int page=0; page<dev->_pages;page++) {
+        PAGE_t * _page = &dev->_page[page];
+        if (_page->_dirtyEnd <= _page->_dirtyStart) continue;
+        ssd1306_send_segs(dev, page, _page->_dirtyStart, _page->_dirtyEnd - _page->_dirtyStart);
+        _page->_dirtyStart = _page->_dirtyEnd = 0;
+    }
+}
+
+// Addressing commands and the data control byte in front of a span, so
+// both go out in one I2C transaction. Each command gets its own 80h
+// control byte (one command, more control bytes follow), the final 40h
+// turns the rest of the transaction into display data.
+void ssd1306_span_header(SSD1306_t * dev, int page, int seg, uint8_t * header)
+{
+    int _seg = seg + CONFIG_OFFSETX;
+    int _page = page;
+    if (dev->_flip) {
+        _page = (dev->_pages - page) - 1;
+    }
+    header[0] = OLED_CONTROL_BYTE_CMD_SINGLE; // 80
+    header[1] = 0xB0 | _page; // Page Start Address for Page Addressing Mode
+    header[2] = OLED_CONTROL_BYTE_CMD_SINGLE;
+    header[3] = 0x00 + (_seg & 0x0F); // Lower Column Start Address
+    header[4] = OLED_CONTROL_BYTE_CMD_SINGLE;
+    header[5] = 0x10 + ((_seg >> 4) & 0x0F); // Higher Column Start Address
+    header[6] = OLED_CONTROL_BYTE_DATA_STREAM; // 40
+}
+
+// SPI transfers of the internal buffer are queued and still read it
+// after ssd1306_commit() returns; wait before reusing it for a new frame.
+// I2C transfers are done when the call returns.
+void ssd1306_wait(SSD1306_t * dev)
+{
+    if (dev->_address == SPI_ADDRESS) spi_display_wait(dev);
 }
 
 void ssd1306_set_buffer(SSD1306_t * dev, const uint8_t * buffer)
@@ -106,13 +238,11 @@ void ssd1306_get_page(SSD1306_t * dev, int page, uint8_t * buffer)
 
 void ssd1306_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width)
 {
-    if (dev->_address == SPI_ADDRESS) {
-        spi_display_image(dev, page, seg, images, width);
-    } else {
-        i2c_display_image(dev, page, seg, images, width);
-    }
     // Set to internal buffer
-    memcpy(&dev->_page[page]._segs[seg], images, width);
+    if (images != &dev->_page[page]._segs[seg]) {
+        memcpy(&dev->_page[page]._segs[seg], images, width);
+    }
+    ssd1306_flush_segs(dev, page, seg, width);
 }
 
 void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
@@ -132,6 +262,9 @@ void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text
     }
 }
 
+// The text past box_width has to come in from outside the box, which a
+// hardware scroll (a rotation inside the box) cannot do, so this marquee
+// stays in software.
 void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay)
 {
     if (page >= dev->_pages) return;
@@ -147,6 +280,7 @@ void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char *
         ssd1306_display_image(dev, page, _seg, image, 8);
         _seg = _seg + 8;
     }
+    ssd1306_animate_step(dev);
     vTaskDelay(delay);
 
     // Horizontally scroll inside the box
@@ -160,16 +294,67 @@ void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char *
             }
             dev->_page[page]._segs[seg+text_box_pixel-1] = image[_bit];
             ssd1306_display_image(dev, page, seg, &dev->_page[page]._segs[seg], text_box_pixel);
+            ssd1306_animate_step(dev);
             vTaskDelay(delay);
         }
     }
 }
 
+// Marquee of a text that fits into its box, animated by the controller:
+// the box is written once with the text at its right end and then rotates
+// left with no bus traffic for as long as the software marquee would run.
+// The text wraps around instead of leaving the box empty between passes.
+// Returns false when the box cannot be scrolled on its own.
+static bool ssd1306_marquee_hw(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay)
+{
+    int text_box_pixel = box_width * 8;
+    if (text_len > box_width) return false;
+#if !SSD1306_SCROLL_WINDOW
+    // Without a column window the whole page moves
+    if (seg != 0 || text_box_pixel != dev->_width) return false;
+#endif
+
+    uint8_t image[8];
+    for (int i = 0; i < box_width; i++) {
+        int _text = i - (box_width - text_len);
+        memcpy(image, font8x8_basic_tr[(_text < 0) ? 0x20 : (uint8_t)text[_text]], 8);
+        if (invert) ssd1306_invert(image, 8);
+        if (dev->_flip) ssd1306_flip(image, 8);
+        ssd1306_display_image(dev, page, seg + i * 8, image, 8);
+    }
+    ssd1306_animate_sync(dev);
+
+    ssd1306_hw_scroll_t scroll = {
+        .horizontal = -1,
+        .start_page = page,
+        .end_page = page,
+        .start_col = seg,
+        .end_col = seg + text_box_pixel - 1,
+        .interval = delay * portTICK_PERIOD_MS * SSD1306_FRAME_HZ / 1000,
+    };
+    int frames = ssd1306_hardware_scroll_start(dev, &scroll);
+    int steps = (text_len + box_width) * 8;
+    vTaskDelay(pdMS_TO_TICKS(steps * frames * 1000 / SSD1306_FRAME_HZ));
+    ssd1306_hardware_scroll_stop(dev);
+
+    // End like the software marquee, with an empty box. This also rewrites
+    // the RAM the scroll has left undefined.
+    memcpy(image, font8x8_basic_tr[0x20], 8);
+    if (invert) ssd1306_invert(image, 8);
+    if (dev->_flip) ssd1306_flip(image, 8);
+    for (int i = 0; i < box_width; i++) {
+        ssd1306_display_image(dev, page, seg + i * 8, image, 8);
+    }
+    ssd1306_animate_sync(dev);
+    return true;
+}
+
 void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay)
 {
     if (page >= dev->_pages) return;
     int text_box_pixel = box_width * 8;
     if (seg + text_box_pixel > dev->_width) return;
+    if (ssd1306_marquee_hw(dev, page, seg, text, box_width, text_len, invert, delay)) return;
 
     int _seg = seg;
     uint8_t image[8];
@@ -182,6 +367,7 @@ void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char *
         ssd1306_display_image(dev, page, _seg, image, 8);
         _seg = _seg + 8;
     }
+    ssd1306_animate_step(dev);
     vTaskDelay(delay);
 
     // Horizontally scroll inside the box
@@ -195,6 +381,7 @@ void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char *
             }
             dev->_page[page]._segs[seg+text_box_pixel-1] = image[_bit];
             ssd1306_display_image(dev, page, seg, &dev->_page[page]._segs[seg], text_box_pixel);
+            ssd1306_animate_step(dev);
             vTaskDelay(delay);
         }
     }
@@ -210,6 +397,7 @@ void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char *
             }
             dev->_page[page]._segs[seg+text_box_pixel-1] = image[_bit];
             ssd1306_display_image(dev, page, seg, &dev->_page[page]._segs[seg], text_box_pixel);
+            ssd1306_animate_step(dev);
             vTaskDelay(delay);
         }
     }
@@ -217,63 +405,64 @@ void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char *
 
 void ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert)
 {
-    if (page >= dev->_pages) return;
-    int _text_len = text_len;
-    if (_text_len > 5) _text_len = 5;
-
-    int seg = 0;
+    ssd1306_display_text_scaled(dev, page, 0, text, text_len, 3, invert);
+}
 
-    for (int nn = 0; nn < _text_len; nn++) {
-        uint8_t const * const in_columns = font8x8_basic_tr[(uint8_t)text[nn]];
-        out_column_t out_columns[8];
-        memset(out_columns, 0, sizeof(out_columns));
-
-        for (int xx = 0; xx < 8; xx++) {
-            uint32_t in_bitmask = 0b1;
-            uint32_t out_bitmask = 0b111;
-            for (int yy = 0; yy < 8; yy++) {
-                if (in_columns[xx] & in_bitmask) {
-                    out_columns[xx].u32 |= out_bitmask;
-                }
-                in_bitmask <<= 1;
-                out_bitmask <<= 3;
-            }
-        }
+// Row 'yy' (0 .. scale-1) of the pre-expanded glyph for 'ch', 8*scale segs long
+static const uint8_t * ssd1306_scaled_glyph(char ch, int scale, int yy)
+{
+    uint8_t code = (uint8_t)ch;
+    if (code < FONT8X8_SCALED_FIRST || code > FONT8X8_SCALED_LAST) code = ' ';
+    code -= FONT8X8_SCALED_FIRST;
+    switch (scale) {
+    case 2: return font8x8_x2_tr[code][yy];
+    case 3: return font8x8_x3_tr[code][yy];
+    default: return font8x8_x4_tr[code][yy];
+    }
+}
 
-        for (int yy = 0; yy < 3; yy++)  {
-            uint8_t image[24];
-            for (int xx = 0; xx < 8; xx++) {
-                image[xx*3+0] = 
-                image[xx*3+1] = 
-                image[xx*3+2] = out_columns[xx].u8[yy];
-            }
-            if (invert) ssd1306_invert(image, 24);
-            if (dev->_flip) ssd1306_flip(image, 24);
-            if (dev->_address == SPI_ADDRESS) {
-                spi_display_image(dev, page+yy, seg, image, 24);
+void ssd1306_display_text_scaled(SSD1306_t * dev, int page, int seg, const char * text, int text_len, int scale, bool invert)
+{
+    if (scale < 1 || scale > FONT8X8_SCALE_MAX) return;
+    if (page + scale > dev->_pages) return;
+    if (seg >= dev->_width) return;
+
+    // As many glyphs as fit between seg and the right edge
+    int glyph_width = 8 * scale;
+    int _text_len = (dev->_width - seg) / glyph_width;
+    if (_text_len > text_len) _text_len = text_len;
+    if (_text_len <= 0) return;
+
+    for (int yy = 0; yy < scale; yy++) {
+        uint8_t * segs = &dev->_page[page+yy]._segs[seg];
+        for (int nn = 0; nn < _text_len; nn++) {
+            if (scale == 1) {
+                memcpy(segs, font8x8_basic_tr[(uint8_t)text[nn]], 8);
             } else {
-                i2c_display_image(dev, page+yy, seg, image, 24);
+                memcpy(segs, ssd1306_scaled_glyph(text[nn], scale, yy), glyph_width);
             }
-            memcpy(&dev->_page[page+yy]._segs[seg], image, 24);
+            segs += glyph_width;
         }
-        seg = seg + 24;
+        int width = _text_len * glyph_width;
+        if (invert) ssd1306_invert(&dev->_page[page+yy]._segs[seg], width);
+        if (dev->_flip) ssd1306_flip(&dev->_page[page+yy]._segs[seg], width);
+        ssd1306_flush_segs(dev, page+yy, seg, width);
     }
 }
 
 void ssd1306_clear_screen(SSD1306_t * dev, bool invert)
 {
-    char space[16];
-    memset(space, 0x00, sizeof(space));
     for (int page = 0; page < dev->_pages; page++) {
-        ssd1306_display_text(dev, page, space, sizeof(space), invert);
+        ssd1306_clear_line(dev, page, invert);
     }
 }
 
 void ssd1306_clear_line(SSD1306_t * dev, int page, bool invert)
 {
-    char space[16];
-    memset(space, 0x00, sizeof(space));
-    ssd1306_display_text(dev, page, space, sizeof(space), invert);
+    if (page >= dev->_pages) return;
+    // Same result as drawing 16 blank glyphs, but one transfer per page
+    memset(dev->_page[page]._segs, invert ? 0xFF : 0x00, dev->_width);
+    ssd1306_flush_segs(dev, page, 0, dev->_width);
 }
 
 void ssd1306_contrast(SSD1306_t * dev, int contrast)
@@ -304,20 +493,13 @@ void ssd1306_scroll_text(SSD1306_t * dev, const char * text, int text_len, bool
 {
     if (dev->_scEnable == false) return;
 
-    void (*func)(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
-    if (dev->_address == SPI_ADDRESS) {
-        func = spi_display_image;
-    } else {
-        func = i2c_display_image;
-    }
-
     int srcIndex = dev->_scEnd - dev->_scDirection;
     while(1) {
         int dstIndex = srcIndex + dev->_scDirection;
         for(int seg = 0; seg < dev->_width; seg++) {
             dev->_page[dstIndex]._segs[seg] = dev->_page[srcIndex]._segs[seg];
         }
-        (*func)(dev, dstIndex, 0, dev->_page[dstIndex]._segs, sizeof(dev->_page[dstIndex]._segs));
+        ssd1306_flush_segs(dev, dstIndex, 0, sizeof(dev->_page[dstIndex]._segs));
         if (srcIndex == dev->_scStart) break;
         srcIndex = srcIndex - dev->_scDirection;
     }
@@ -339,12 +521,203 @@ void ssd1306_scroll_clear(SSD1306_t * dev)
     }
 }
 
-void ssd1306_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
+// Step interval codes of the scroll commands, by frame count
+static const struct {
+    uint16_t frames;
+    uint8_t code;
+} ssd1306_scroll_intervals[] = {
+    { 2, 0x07 }, { 3, 0x04 }, { 4, 0x05 }, { 5, 0x00 },
+    { 25, 0x06 }, { 64, 0x01 }, { 128, 0x02 }, { 256, 0x03 },
+};
+
+// Nearest interval the controller has (by ratio), returns its frame count
+static int ssd1306_scroll_interval(int frames, uint8_t * code)
 {
-    if (dev->_address == SPI_ADDRESS) {
-        spi_hardware_scroll(dev, scroll);
+    int best = 0;
+    int bestRatio = 0;
+    if (frames < 1) frames = 1;
+    for (int i = 0; i < sizeof(ssd1306_scroll_intervals) / sizeof(ssd1306_scroll_intervals[0]); i++) {
+        int f = ssd1306_scroll_intervals[i].frames;
+        int ratio = (f > frames) ? f * 256 / frames : frames * 256 / f;
+        if (i == 0 || ratio < bestRatio) {
+            best = i;
+            bestRatio = ratio;
+        }
+    }
+    *code = ssd1306_scroll_intervals[best].code;
+    return ssd1306_scroll_intervals[best].frames;
+}
+
+// Start a continuous scroll of the panel RAM. The controller keeps moving
+// the picture on its own until ssd1306_hardware_scroll_stop(); afterwards
+// the RAM content is undefined and has to be sent again.
+// Returns the frames per step that are actually used.
+int ssd1306_hardware_scroll_start(SSD1306_t * dev, const ssd1306_hw_scroll_t * scroll)
+{
+    int start_page = scroll->start_page;
+    int end_page = scroll->end_page;
+    if (start_page < 0) start_page = 0;
+    if (end_page >= dev->_pages) end_page = dev->_pages - 1;
+    if (end_page < start_page) end_page = start_page;
+    int vertical = scroll->vertical;
+    if (dev->_flip) {
+        // Pages and rows are mirrored on a flipped panel, columns are not
+        int _start = (dev->_pages - end_page) - 1;
+        end_page = (dev->_pages - start_page) - 1;
+        start_page = _start;
+        vertical = -vertical;
+    }
+    uint8_t interval;
+    int frames = ssd1306_scroll_interval(scroll->interval, &interval);
+
+    uint8_t commands[16];
+    int n = 0;
+    // Parameters must not change while a scroll is running
+    commands[n++] = OLED_CMD_DEACTIVE_SCROLL; // 2E
+    if (vertical == 0) {
+        int start_col = 0x00;
+        int end_col = 0xFF;
+#if SSD1306_SCROLL_WINDOW
+        if (scroll->start_col > 0 || scroll->end_col < dev->_width - 1) {
+            start_col = scroll->start_col + CONFIG_OFFSETX;
+            end_col = scroll->end_col + CONFIG_OFFSETX;
+        }
+#endif
+        commands[n++] = (scroll->horizontal < 0) ? OLED_CMD_HORIZONTAL_LEFT : OLED_CMD_HORIZONTAL_RIGHT; // 27 / 26
+        commands[n++] = 0x00; // Dummy byte
+        commands[n++] = start_page;
+        commands[n++] = interval;
+        commands[n++] = end_page;
+        commands[n++] = start_col;
+        commands[n++] = end_col;
     } else {
-        i2c_hardware_scroll(dev, scroll);
+        int rows = scroll->scroll_rows;
+        if (rows <= 0 || scroll->fixed_rows + rows > dev->_height) rows = dev->_height - scroll->fixed_rows;
+        commands[n++] = OLED_CMD_VERTICAL; // A3
+        commands[n++] = scroll->fixed_rows;
+        commands[n++] = rows;
+        commands[n++] = (scroll->horizontal < 0) ? OLED_CMD_CONTINUOUS_SCROLL_LEFT : OLED_CMD_CONTINUOUS_SCROLL; // 2A / 29
+        commands[n++] = 0x00; // Dummy byte
+        commands[n++] = start_page;
+        commands[n++] = interval;
+        commands[n++] = end_page;
+        commands[n++] = vertical & 0x3F; // Vertical offset, 3Fh is one row down
+    }
+    commands[n++] = OLED_CMD_ACTIVE_SCROLL; // 2F
+    ssd1306_write_commands(dev, commands, n);
+    return frames;
+}
+
+void ssd1306_hardware_scroll_stop(SSD1306_t * dev)
+{
+    uint8_t command = OLED_CMD_DEACTIVE_SCROLL; // 2E
+    ssd1306_write_commands(dev, &command, 1);
+}
+
+void ssd1306_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
+{
+    // The classic presets: whole panel sideways, or page 0 sideways plus
+    // the whole panel up or down, one step every 2 frames
+    ssd1306_hw_scroll_t _scroll = {
+        .horizontal = 1,
+        .start_page = 0,
+        .end_page = dev->_pages - 1,
+        .end_col = dev->_width - 1,
+        .interval = 2,
+    };
+    switch (scroll) {
+    case SCROLL_RIGHT:
+        break;
+    case SCROLL_LEFT:
+        _scroll.horizontal = -1;
+        break;
+    case SCROLL_DOWN:
+    case SCROLL_UP:
+        _scroll.vertical = (scroll == SCROLL_UP) ? 1 : -1;
+        _scroll.end_page = 0;
+        break;
+    case SCROLL_STOP:
+        ssd1306_hardware_scroll_stop(dev);
+        return;
+    default:
+        return;
+    }
+    ssd1306_hardware_scroll_start(dev, &_scroll);
+}
+
+// The viewport functions move what the panel shows with the display
+// start line instead of moving the buffer. The controller treats its 64
+// RAM rows as a ring: panel row y shows buffer row (y + _startLine) % 64,
+// see ssd1306_viewport_row(). Only panels as tall as the RAM can use it.
+static bool ssd1306_viewport_ok(SSD1306_t * dev)
+{
+    if (dev->_pages * 8 == 64) return true;
+    ESP_LOGW(TAG, "Viewport scrolling needs a 64 row panel");
+    return false;
+}
+
+void ssd1306_set_start_line(SSD1306_t * dev, int line)
+{
+    if (!ssd1306_viewport_ok(dev)) return;
+    line &= 63;
+    dev->_startLine = line;
+    // Flipped panels scan the RAM bottom up, so the ring turns the other way
+    if (dev->_flip) line = (64 - line) & 63;
+    uint8_t command = OLED_CMD_SET_DISPLAY_START_LINE | line;
+    ssd1306_write_commands(dev, &command, 1);
+}
+
+// Raw display offset (COM shift), mostly for panels mounted with an offset.
+// Unlike the start line it is not tracked by ssd1306_viewport_row().
+void ssd1306_set_display_offset(SSD1306_t * dev, int offset)
+{
+    uint8_t commands[2] = { OLED_CMD_SET_DISPLAY_OFFSET, offset & 63 };
+    ssd1306_write_commands(dev, commands, 2);
+}
+
+// Positive lines move the content up, the rows that scroll in at the
+// bottom show whatever the buffer rows that left at the top contain.
+void ssd1306_viewport_scroll(SSD1306_t * dev, int lines)
+{
+    ssd1306_set_start_line(dev, dev->_startLine + lines);
+}
+
+int ssd1306_viewport_row(SSD1306_t * dev, int y)
+{
+    return (y + dev->_startLine) % (dev->_pages * 8);
+}
+
+// Append a line of 8x8 text at the bottom and scroll the old content up,
+// one pixel row per step. Every step sends one page and one command: the
+// new text row goes into the buffer row that is leaving at the top, which
+// is the row the start line change brings in at the bottom. The row has
+// to be written before that change, the flush task included.
+void ssd1306_console_print(SSD1306_t * dev, const char * text, bool invert, int delay)
+{
+    if (!ssd1306_viewport_ok(dev)) return;
+    if (dev->_startLine % 8) ssd1306_set_start_line(dev, dev->_startLine & ~7);
+
+    uint8_t line[128];
+    int len = strlen(text);
+    for (int i = 0; i < 16; i++) {
+        const uint8_t * glyph = font8x8_basic_tr[(i < len) ? (uint8_t)text[i] & 0x7F : ' '];
+        for (int c = 0; c < 8; c++) line[i * 8 + c] = invert ? ~glyph[c] : glyph[c];
+    }
+
+    int page = dev->_startLine / 8;
+    uint8_t * segs = dev->_page[page]._segs;
+    for (int row = 0; row < 8; row++) {
+        uint8_t mask = 1 << row;
+        uint8_t _mask = dev->_flip ? ssd1306_rotate_byte(mask) : mask;
+        for (int seg = 0; seg < 128; seg++) {
+            uint8_t bits = line[seg] & mask;
+            if (dev->_flip) bits = ssd1306_rotate_byte(bits);
+            segs[seg] = (segs[seg] & ~_mask) | bits;
+        }
+        ssd1306_flush_segs(dev, page, 0, dev->_width);
+        ssd1306_animate_sync(dev);
+        ssd1306_viewport_scroll(dev, 1);
+        if (delay) vTaskDelay(delay);
     }
 }
 
@@ -375,69 +748,9 @@ void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int sta
             dev->_page[page]._segs[127] = wk;
         }
     } else if (scroll == SCROLL_UP) {
-        int _start = start; 
-        int _end = end; 
-        if (_end >= dev->_width) _end = dev->_width - 1;
-        uint8_t wk0, wk1, wk2;
-        uint8_t save[128];
-        for (int seg=0;seg<128;seg++) save[seg] = dev->_page[0]._segs[seg];
-        for (int page=0;page<dev->_pages-1;page++) {
-            for (int seg=_start;seg<=_end;seg++) {
-                wk0 = dev->_page[page]._segs[seg];
-                wk1 = dev->_page[page+1]._segs[seg];
-                if (dev->_flip) { wk0 = ssd1306_rotate_byte(wk0); wk1 = ssd1306_rotate_byte(wk1); }
-                wk0 = wk0 >> 1;
-                wk1 = wk1 & 0x01;
-                wk1 = wk1 << 7;
-                wk2 = wk0 | wk1;
-                if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-                dev->_page[page]._segs[seg] = wk2;
-            }
-        }
-        int pages = dev->_pages-1;
-        for (int seg=_start;seg<=_end;seg++) {
-            wk0 = dev->_page[pages]._segs[seg];
-            wk1 = save[seg];
-            if (dev->_flip) { wk0 = ssd1306_rotate_byte(wk0); wk1 = ssd1306_rotate_byte(wk1); }
-            wk0 = wk0 >> 1;
-            wk1 = wk1 & 0x01;
-            wk1 = wk1 << 7;
-            wk2 = wk0 | wk1;
-            if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-            dev->_page[pages]._segs[seg] = wk2;
-        }
+        ssd1306_vertical_shift(dev, start, end, -1, true);
     } else if (scroll == SCROLL_DOWN) {
-        int _start = start; 
-        int _end = end; 
-        if (_end >= dev->_width) _end = dev->_width - 1;
-        uint8_t wk0, wk1, wk2;
-        uint8_t save[128];
-        int pages = dev->_pages-1;
-        for (int seg=0;seg<128;seg++) save[seg] = dev->_page[pages]._segs[seg];
-        for (int page=pages;page>0;page--) {
-            for (int seg=_start;seg<=_end;seg++) {
-                wk0 = dev->_page[page]._segs[seg];
-                wk1 = dev->_page[page-1]._segs[seg];
-                if (dev->_flip) { wk0 = ssd1306_rotate_byte(wk0); wk1 = ssd1306_rotate_byte(wk1); }
-                wk0 = wk0 << 1;
-                wk1 = wk1 & 0x80;
-                wk1 = wk1 >> 7;
-                wk2 = wk0 | wk1;
-                if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-                dev->_page[page]._segs[seg] = wk2;
-            }
-        }
-        for (int seg=_start;seg<=_end;seg++) {
-            wk0 = dev->_page[0]._segs[seg];
-            wk1 = save[seg];
-            if (dev->_flip) { wk0 = ssd1306_rotate_byte(wk0); wk1 = ssd1306_rotate_byte(wk1); }
-            wk0 = wk0 << 1;
-            wk1 = wk1 & 0x80;
-            wk1 = wk1 >> 7;
-            wk2 = wk0 | wk1;
-            if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-            dev->_page[0]._segs[seg] = wk2;
-        }
+        ssd1306_vertical_shift(dev, start, end, 1, true);
     } else if (scroll == PAGE_SCROLL_DOWN) {
         uint8_t save[128];
         for (int seg=0;seg<128;seg++) save[seg] = dev->_page[dev->_pages-1]._segs[seg];
@@ -456,11 +769,7 @@ void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int sta
 
     if (delay >= 0) {
         for (int page=0;page<dev->_pages;page++) {
-            if (dev->_address == SPI_ADDRESS) {
-                spi_display_image(dev, page, 0, dev->_page[page]._segs, 128);
-            } else {
-                i2c_display_image(dev, page, 0, dev->_page[page]._segs, 128);
-            }
+            ssd1306_flush_segs(dev, page, 0, 128);
             if (delay) vTaskDelay(delay);
         }
     }
@@ -468,105 +777,206 @@ void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int sta
 
 void _ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
 {
-    if ( (width % 8) != 0) {
-        ESP_LOGE(TAG, "width must be a multiple of 8");
-        return;
+    _ssd1306_blit(dev, xpos, ypos, bitmap, width, height, SSD1306_ROP_COPY, invert);
+}
+
+void ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
+{
+    ssd1306_blit(dev, xpos, ypos, bitmap, width, height, SSD1306_ROP_COPY, invert);
+}
+
+static void ssd1306_rop_byte(uint8_t * dst, uint8_t src, uint8_t mask, ssd1306_rop_t rop)
+{
+    switch (rop) {
+    case SSD1306_ROP_OR:  *dst |= src & mask; break;
+    case SSD1306_ROP_AND: *dst &= src | ~mask; break;
+    case SSD1306_ROP_XOR: *dst ^= src & mask; break;
+    default:              *dst = (*dst & ~mask) | (src & mask); break;
     }
-    int _width = width / 8;
-    uint8_t wk0;
-    uint8_t wk1;
-    uint8_t wk2;
-    uint8_t page = (ypos / 8);
-    uint8_t _seg = xpos;
-    uint8_t dstBits = (ypos % 8);
-    int offset = 0;
-    for(int _height=0;_height<height;_height++) {
-        for (int index=0;index<_width;index++) {
-            for (int srcBits=7; srcBits>=0; srcBits--) {
-                wk0 = dev->_page[page]._segs[_seg];
-                if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-
-                wk1 = bitmap[index+offset];
-                if (invert) wk1 = ~wk1;
-
-                wk2 = ssd1306_copy_bit(wk1, srcBits, wk0, dstBits);
-                if (dev->_flip) wk2 = ssd1306_rotate_byte(wk2);
-
-                if (_seg >= 128) break;
-                if (page >= dev->_pages) break;
-                dev->_page[page]._segs[_seg] = wk2;
-                _seg++;
-            }
+}
+
+// Row-major bitmap (MSB first, (width+7)/8 bytes per row) to GDDRAM pages.
+// Every destination page takes the 8 source rows that land in it, so the
+// vertical offset needs no bit shifting, and every 8 columns of those rows
+// are turned into 8 page bytes with one word-wise transpose.
+void _ssd1306_blit(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, ssd1306_rop_t rop, bool invert)
+{
+    int stride = (width + 7) / 8;
+    int x0 = (xpos < 0) ? 0 : xpos;
+    int x1 = (xpos + width > dev->_width) ? dev->_width : xpos + width;
+    int y0 = (ypos < 0) ? 0 : ypos;
+    int y1 = (ypos + height > dev->_height) ? dev->_height : ypos + height;
+    if (x1 <= x0 || y1 <= y0) return;
+
+    // Source bytes that have at least one visible column
+    int b0 = (x0 - xpos) / 8;
+    int b1 = (x1 - xpos + 7) / 8;
+
+    for (int page = y0 / 8; page <= (y1 - 1) / 8; page++) {
+        uint8_t rowMask = 0;
+        const uint8_t * rows[8];
+        for (int r = 0; r < 8; r++) {
+            int y = page * 8 + r;
+            rows[r] = NULL;
+            if (y < y0 || y >= y1) continue;
+            rows[r] = &bitmap[(y - ypos) * stride];
+            rowMask |= 1 << r;
         }
-        offset = offset + _width;
-        dstBits++;
-        _seg = xpos;
-        if (dstBits == 8) {
-            page++;
-            dstBits=0;
+        uint8_t mask = rowMask;
+        if (dev->_flip) mask = ssd1306_rotate_byte(mask);
+
+        for (int b = b0; b < b1; b++) {
+            uint8_t in[8];
+            for (int r = 0; r < 8; r++) {
+                in[r] = rows[r] ? rows[r][b] : 0;
+                if (invert) in[r] = ~in[r];
+            }
+            uint32_t hi = ((uint32_t)in[7] << 24) | (in[6] << 16) | (in[5] << 8) | in[4];
+            uint32_t lo = ((uint32_t)in[3] << 24) | (in[2] << 16) | (in[1] << 8) | in[0];
+            ssd1306_transpose8(&hi, &lo);
+            uint8_t out[8] = {
+                hi >> 24, hi >> 16, hi >> 8, hi,
+                lo >> 24, lo >> 16, lo >> 8, lo
+            };
+
+            int x = xpos + b * 8;
+            for (int c = 0; c < 8; c++, x++) {
+                if (x < x0 || x >= x1) continue;
+                uint8_t src = out[c];
+                if (dev->_flip) src = ssd1306_rotate_byte(src);
+                ssd1306_rop_byte(&dev->_page[page]._segs[x], src, mask, rop);
+            }
         }
     }
 }
 
-void ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
+// Flush the pages and segs covered by a rectangle, clipped to the panel
+static void ssd1306_flush_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height)
 {
-    _ssd1306_bitmaps(dev, xpos, ypos, bitmap, width, height, invert);
-    int start_page = ypos / 8;
-    int end_page = (ypos + height - 1) / 8;
-    int start_seg = xpos;
-    int end_seg = xpos + width - 1;
-
-    for (int page = start_page; page <= end_page; page++) {
-        int seg_start = (page == start_page) ? start_seg : 0;
-        int seg_end = (page == end_page) ? end_seg : 127;
-        int seg_width = seg_end - seg_start + 1;
-        ssd1306_display_image(dev, page, seg_start, &dev->_page[page]._segs[seg_start], seg_width);
+    int x0 = (xpos < 0) ? 0 : xpos;
+    int x1 = (xpos + width > dev->_width) ? dev->_width : xpos + width;
+    int y0 = (ypos < 0) ? 0 : ypos;
+    int y1 = (ypos + height > dev->_height) ? dev->_height : ypos + height;
+    if (x1 <= x0 || y1 <= y0) return;
+    for (int page = y0 / 8; page <= (y1 - 1) / 8; page++) {
+        ssd1306_flush_segs(dev, page, x0, x1 - x0);
     }
 }
 
+void ssd1306_blit(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, ssd1306_rop_t rop, bool invert)
+{
+    _ssd1306_blit(dev, xpos, ypos, bitmap, width, height, rop, invert);
+    ssd1306_flush_rect(dev, xpos, ypos, width, height);
+}
+
 void _ssd1306_pixel(SSD1306_t * dev, int xpos, int ypos, bool invert)
 {
-    uint8_t _page = (ypos / 8);
-    uint8_t _bits = (ypos % 8);
-    uint8_t _seg = xpos;
-    uint8_t wk0 = dev->_page[_page]._segs[_seg];
-    uint8_t wk1 = 1 << _bits;
+    if (xpos < 0 || xpos >= dev->_width || ypos < 0 || ypos >= dev->_height) return;
+    uint8_t wk = 1 << (ypos % 8);
+    if (dev->_flip) wk = ssd1306_rotate_byte(wk);
+    uint8_t * seg = &dev->_page[ypos / 8]._segs[xpos];
     if (invert) {
-        wk0 = wk0 & ~wk1;
+        *seg &= ~wk;
     } else {
-        wk0 = wk0 | wk1;
+        *seg |= wk;
     }
-    if (dev->_flip) wk0 = ssd1306_rotate_byte(wk0);
-    dev->_page[_page]._segs[_seg] = wk0;
 }
 
+// Set (or clear with invert) rows y0..y1 of segs x0..x1, both inclusive
+// and already clipped. Pages fully inside the span are a memset, the top
+// and bottom page get one masked byte per seg.
+static void ssd1306_fill_span(SSD1306_t * dev, int x0, int x1, int y0, int y1, bool invert)
+{
+    int width = x1 - x0 + 1;
+    for (int page = y0 / 8; page <= y1 / 8; page++) {
+        int top = (page == y0 / 8) ? y0 % 8 : 0;
+        int bottom = (page == y1 / 8) ? y1 % 8 : 7;
+        uint8_t mask = (0xFF << top) & (0xFF >> (7 - bottom));
+        uint8_t * segs = &dev->_page[page]._segs[x0];
+        if (mask == 0xFF) {
+            memset(segs, invert ? 0x00 : 0xFF, width);
+            continue;
+        }
+        if (dev->_flip) mask = ssd1306_rotate_byte(mask);
+        if (invert) {
+            for (int i = 0; i < width; i++) segs[i] &= ~mask;
+        } else {
+            for (int i = 0; i < width; i++) segs[i] |= mask;
+        }
+    }
+}
+
+// Order and clip an inclusive rectangle, false when nothing is left
+static bool ssd1306_clip(SSD1306_t * dev, int * x0, int * y0, int * x1, int * y1)
+{
+    int t;
+    if (*x0 > *x1) { t = *x0; *x0 = *x1; *x1 = t; }
+    if (*y0 > *y1) { t = *y0; *y0 = *y1; *y1 = t; }
+    if (*x0 < 0) *x0 = 0;
+    if (*y0 < 0) *y0 = 0;
+    if (*x1 >= dev->_width) *x1 = dev->_width - 1;
+    if (*y1 >= dev->_height) *y1 = dev->_height - 1;
+    return (*x0 <= *x1 && *y0 <= *y1);
+}
+
+void _ssd1306_hline(SSD1306_t * dev, int x1, int x2, int y, bool invert)
+{
+    int y2 = y;
+    if (ssd1306_clip(dev, &x1, &y, &x2, &y2)) ssd1306_fill_span(dev, x1, x2, y, y2, invert);
+}
+
+void _ssd1306_vline(SSD1306_t * dev, int x, int y1, int y2, bool invert)
+{
+    int x2 = x;
+    if (ssd1306_clip(dev, &x, &y1, &x2, &y2)) ssd1306_fill_span(dev, x, x2, y1, y2, invert);
+}
+
+// Bresenham, but every run of pixels on the same row (or column for steep
+// lines) is drawn as one span.
 void _ssd1306_line(SSD1306_t * dev, int x1, int y1, int x2, int y2,  bool invert)
 {
     int i;
     int dx,dy;
     int sx,sy;
     int E;
+    int run;
     dx = ( x2 > x1 ) ? x2 - x1 : x1 - x2;
     dy = ( y2 > y1 ) ? y2 - y1 : y1 - y2;
     sx = ( x2 > x1 ) ? 1 : -1;
     sy = ( y2 > y1 ) ? 1 : -1;
-    if ( dx > dy ) {
+    if ( dy == 0 ) {
+        _ssd1306_hline(dev, x1, x2, y1, invert);
+    } else if ( dx == 0 ) {
+        _ssd1306_vline(dev, x1, y1, y2, invert);
+    } else if ( dx > dy ) {
         E = -dx;
+        run = x1;
         for ( i = 0 ; i <= dx ; i++ ) {
-            _ssd1306_pixel(dev, x1, y1, invert);
+            int x = x1;
             x1 += sx;
             E += 2 * dy;
+            if ( E >= 0 || i == dx ) {
+                if (run == x) _ssd1306_pixel(dev, x, y1, invert);
+                else _ssd1306_hline(dev, run, x, y1, invert);
+                run = x1;
+            }
             if ( E >= 0 ) {
-            y1 += sy;
-            E -= 2 * dx;
+                y1 += sy;
+                E -= 2 * dx;
+            }
         }
-    }
     } else {
         E = -dy;
+        run = y1;
         for ( i = 0 ; i <= dy ; i++ ) {
-            _ssd1306_pixel(dev, x1, y1, invert);
+            int y = y1;
             y1 += sy;
             E += 2 * dx;
+            if ( E >= 0 || i == dy ) {
+                if (run == y) _ssd1306_pixel(dev, x1, y, invert);
+                else _ssd1306_vline(dev, x1, run, y, invert);
+                run = y1;
+            }
             if ( E >= 0 ) {
                 x1 += sx;
                 E -= 2 * dy;
@@ -575,6 +985,87 @@ void _ssd1306_line(SSD1306_t * dev, int x1, int y1, int x2, int y2,  bool invert
     }
 }
 
+void _ssd1306_fill_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert)
+{
+    if (width <= 0 || height <= 0) return;
+    int x1 = xpos + width - 1;
+    int y1 = ypos + height - 1;
+    if (ssd1306_clip(dev, &xpos, &ypos, &x1, &y1)) ssd1306_fill_span(dev, xpos, x1, ypos, y1, invert);
+}
+
+void ssd1306_fill_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert)
+{
+    _ssd1306_fill_rect(dev, xpos, ypos, width, height, invert);
+    ssd1306_flush_rect(dev, xpos, ypos, width, height);
+}
+
+void _ssd1306_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert)
+{
+    _ssd1306_round_rect(dev, xpos, ypos, width, height, 0, invert);
+}
+
+// Outline with quarter circle corners of radius r
+void _ssd1306_round_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, int r, bool invert)
+{
+    if (width <= 0 || height <= 0) return;
+    if (r > (width - 1) / 2) r = (width - 1) / 2;
+    if (r > (height - 1) / 2) r = (height - 1) / 2;
+    if (r < 0) r = 0;
+    int left = xpos + r;
+    int right = xpos + width - 1 - r;
+    int top = ypos + r;
+    int bottom = ypos + height - 1 - r;
+    _ssd1306_hline(dev, left, right, ypos, invert);
+    _ssd1306_hline(dev, left, right, ypos + height - 1, invert);
+    _ssd1306_vline(dev, xpos, top, bottom, invert);
+    _ssd1306_vline(dev, xpos + width - 1, top, bottom, invert);
+    if (r == 0) return;
+
+    int x=0;
+    int y=-r;
+    int err=2-2*r;
+    int old_err;
+    do{
+        _ssd1306_pixel(dev, left-x, top+y, invert);
+        _ssd1306_pixel(dev, right+x, top+y, invert);
+        _ssd1306_pixel(dev, left-x, bottom-y, invert);
+        _ssd1306_pixel(dev, right+x, bottom-y, invert);
+        if ((old_err=err)<=x) err+=++x*2+1;
+        if (old_err>y || err>x) err+=++y*2+1;
+    } while(y<0);
+}
+
+// Filled box with quarter circle corners of radius r: the middle is one
+// span, the corner columns are vertical spans like in _ssd1306_disc.
+void _ssd1306_fill_round_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, int r, bool invert)
+{
+    if (width <= 0 || height <= 0) return;
+    if (r > (width - 1) / 2) r = (width - 1) / 2;
+    if (r > (height - 1) / 2) r = (height - 1) / 2;
+    if (r < 0) r = 0;
+    int left = xpos + r;
+    int right = xpos + width - 1 - r;
+    int top = ypos + r;
+    int bottom = ypos + height - 1 - r;
+    _ssd1306_fill_rect(dev, left, ypos, right - left + 1, height, invert);
+    if (r == 0) return;
+
+    int x=0;
+    int y=-r;
+    int err=2-2*r;
+    int old_err;
+    int ChangeX=1;
+    do{
+        if (ChangeX && x > 0) {
+            _ssd1306_vline(dev, left-x, top+y, bottom-y, invert);
+            _ssd1306_vline(dev, right+x, top+y, bottom-y, invert);
+        }
+        ChangeX=(old_err=err)<=x;
+        if (ChangeX) err+=++x*2+1;
+        if (old_err>y || err>x) err+=++y*2+1;
+    } while(y<=0);
+}
+
 void _ssd1306_circle(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert)
 {
     int x;
@@ -598,6 +1089,8 @@ void _ssd1306_circle(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, b
     } while(y<0);
 }
 
+// Every column of the disc is one vertical span; the upper and lower
+// quadrants of a side are merged into a single span.
 void _ssd1306_disc(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert)
 {
     int x;
@@ -611,14 +1104,14 @@ void _ssd1306_disc(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, boo
     ChangeX=1;
     do{
         if(ChangeX) {
-            if ((opt & OLED_DRAW_LOWER_LEFT) == OLED_DRAW_LOWER_LEFT)
-                _ssd1306_line(dev, x0-x, y0-y, x0-x, y0, invert);
-            if ((opt & OLED_DRAW_UPPER_LEFT) == OLED_DRAW_UPPER_LEFT)
-                _ssd1306_line(dev, x0-x, y0, x0-x, y0+y, invert);
-            if ((opt & OLED_DRAW_LOWER_RIGHT) == OLED_DRAW_LOWER_RIGHT)
-                _ssd1306_line(dev, x0+x, y0-y, x0+x, y0, invert);
-            if ((opt & OLED_DRAW_UPPER_RIGHT) == OLED_DRAW_UPPER_RIGHT)
-                _ssd1306_line(dev, x0+x, y0, x0+x, y0+y, invert);
+            if (opt & (OLED_DRAW_UPPER_LEFT|OLED_DRAW_LOWER_LEFT))
+                _ssd1306_vline(dev, x0-x,
+                    (opt & OLED_DRAW_UPPER_LEFT) ? y0+y : y0,
+                    (opt & OLED_DRAW_LOWER_LEFT) ? y0-y : y0, invert);
+            if (opt & (OLED_DRAW_UPPER_RIGHT|OLED_DRAW_LOWER_RIGHT))
+                _ssd1306_vline(dev, x0+x,
+                    (opt & OLED_DRAW_UPPER_RIGHT) ? y0+y : y0,
+                    (opt & OLED_DRAW_LOWER_RIGHT) ? y0-y : y0, invert);
         }
         ChangeX=(old_err=err)<=x;
         if (ChangeX) err+=++x*2+1;
@@ -632,105 +1125,146 @@ void _ssd1306_cursor(SSD1306_t * dev, int x0, int y0, int r, bool invert)
     _ssd1306_line(dev, x0, y0-r, x0, y0+r, invert);
 }
 
-void ssd1306_invert(uint8_t *buf, size_t blen)
-{
-    uint8_t wk;
-    for(int i=0; i<blen; i++){
-        wk = buf[i];
-        buf[i] = ~wk;
+void ssd1306_display_rotate_text(SSD1306_t * dev, int seg, const char * text, int text_len, bool invert) {
+    int _text_len = text_len;
+    if (_text_len > 8) _text_len = 8;
+    uint8_t image[8];
+    int _page = dev->_pages-1;
+    for (uint8_t i = 0; i < _text_len; i++) {
+        memcpy(image, font8x8_basic_rot[(uint8_t)text[i] & 0x7F], 8);
+        if (dev->_flip) ssd1306_flip(image, 8);
+        if (invert) ssd1306_invert(image, 8);
+        ssd1306_display_image(dev, _page, seg, image, 8);
+        _page--;
+        if (_page < 0) return;
     }
 }
 
-void ssd1306_flip(uint8_t *buf, size_t blen)
+const ssd1306_font_t ssd1306_font_8x8 = {
+    .first = 0x00,
+    .count = 128,
+    .height = 8,
+    .width = 8,
+    .bitmap = &font8x8_basic_tr[0][0],
+};
+
+const ssd1306_font_t ssd1306_font_prop8 = {
+    .first = FONT_PROP8_FIRST,
+    .count = FONT_PROP8_COUNT,
+    .height = 8,
+    .spacing = 1,
+    .bitmap = font_prop8_bitmap,
+    .offsets = font_prop8_offsets,
+    .kern_pairs = font_prop8_kern_pairs,
+    .kern_adjust = font_prop8_kern_adjust,
+    .kern_count = FONT_PROP8_KERN_COUNT,
+};
+
+// Glyph index of 'ch', code points outside the font fall back to its first glyph
+static int ssd1306_font_index(const ssd1306_font_t * font, char ch)
 {
-    for(int i=0; i<blen; i++){
-        buf[i] = ssd1306_rotate_byte(buf[i]);
-    }
+    int index = (uint8_t)ch - font->first;
+    if (index < 0 || index >= font->count) index = 0;
+    return index;
 }
 
-uint8_t ssd1306_copy_bit(uint8_t src, int srcBits, uint8_t dst, int dstBits)
+static int ssd1306_glyph_width(const ssd1306_font_t * font, int index)
 {
-    uint8_t smask = 0x01 << srcBits;
-    uint8_t dmask = 0x01 << dstBits;
-    uint8_t _src = src & smask;
-    uint8_t _dst;
-    if (_src != 0) {
-        _dst = dst | dmask;
-    } else {
-        _dst = dst & ~(dmask);
-    }
-    return _dst;
+    if (font->offsets == NULL) return font->width;
+    return font->offsets[index+1] - font->offsets[index];
 }
 
-uint8_t ssd1306_rotate_byte(uint8_t ch1) {
-    uint8_t ch2 = 0;
-    for (int j=0;j<8;j++) {
-        ch2 = (ch2 << 1) + (ch1 & 0x01);
-        ch1 = ch1 >> 1;
+static const uint8_t * ssd1306_glyph_bitmap(const ssd1306_font_t * font, int index)
+{
+    int column = (font->offsets == NULL) ? index * font->width : font->offsets[index];
+    return &font->bitmap[column * ((font->height + 7) / 8)];
+}
+
+// Blank columns between 'left' and 'right', spacing plus kerning
+static int ssd1306_glyph_gap(const ssd1306_font_t * font, char left, char right)
+{
+    int gap = font->spacing;
+    uint16_t key = ((uint8_t)left << 8) | (uint8_t)right;
+    int lo = 0;
+    int hi = font->kern_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (font->kern_pairs[mid] == key) {
+            gap += font->kern_adjust[mid];
+            break;
+        }
+        if (font->kern_pairs[mid] < key) lo = mid + 1;
+        else hi = mid - 1;
     }
-    return ch2;
+    return (gap < 0) ? 0 : gap;
 }
 
-void ssd1306_fadeout(SSD1306_t * dev)
+int ssd1306_string_width(const ssd1306_font_t * font, const char * text)
 {
-    void (*func)(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
-    if (dev->_address == SPI_ADDRESS) {
-        func = spi_display_image;
-    } else {
-        func = i2c_display_image;
+    int width = 0;
+    for (int i = 0; text[i] != 0; i++) {
+        if (i > 0) width += ssd1306_glyph_gap(font, text[i-1], text[i]);
+        width += ssd1306_glyph_width(font, ssd1306_font_index(font, text[i]));
     }
+    return width;
+}
 
-    uint8_t image[1];
-    for(int page=0; page<dev->_pages; page++) {
-        image[0] = 0xFF;
-        for(int line=0; line<8; line++) {
-            if (dev->_flip) {
-                image[0] = image[0] >> 1;
-            } else {
-                image[0] = image[0] << 1;
-            }
-            for(int seg=0; seg<128; seg++) {
-                (*func)(dev, page, seg, image, 1);
-                dev->_page[page]._segs[seg] = image[0];
-            }
+// Replace the rows in 'mask' of column xpos, starting at row ypos, with 'bits'
+static void ssd1306_put_column(SSD1306_t * dev, int xpos, int ypos, uint32_t bits, uint32_t mask)
+{
+    if (xpos < 0 || xpos >= dev->_width) return;
+    int page = (ypos >= 0) ? ypos / 8 : -((7 - ypos) / 8);
+    int shift = ypos - page * 8;
+    bits <<= shift;
+    mask <<= shift;
+    for (; mask != 0; page++, bits >>= 8, mask >>= 8) {
+        if (page < 0 || page >= dev->_pages) continue;
+        uint8_t _mask = mask & 0xFF;
+        uint8_t _bits = bits & 0xFF;
+        if (dev->_flip) {
+            _mask = ssd1306_rotate_byte(_mask);
+            _bits = ssd1306_rotate_byte(_bits);
         }
+        uint8_t * seg = &dev->_page[page]._segs[xpos];
+        *seg = (*seg & ~_mask) | (_bits & _mask);
     }
 }
 
-void ssd1306_rotate_image(uint8_t *image, bool flip) {
-    uint8_t _image[8];
-    uint8_t _smask = 0x01;
-    for (int i=0;i<8;i++) {
-        uint8_t _dmask = 0x80;
-        _image[i] = 0;
-        for (int j=0;j<8;j++) {
-            uint8_t _wk = image[j] & _smask;
-            if (_wk != 0) {
-                _image[i] = _image[i] + _dmask;
-            }
-            _dmask = _dmask >> 1;
+int ssd1306_draw_string(SSD1306_t * dev, int xpos, int ypos, const ssd1306_font_t * font, const char * text, bool invert)
+{
+    int height = (font->height > 16) ? 16 : font->height;
+    int bytes = (height + 7) / 8;
+    uint32_t mask = (1u << height) - 1;
+    uint32_t background = invert ? mask : 0;
+    int x = xpos;
+
+    for (int i = 0; text[i] != 0; i++) {
+        if (i > 0) {
+            // Glyphs are opaque, so the gap is painted with the background too
+            int gap = ssd1306_glyph_gap(font, text[i-1], text[i]);
+            for (int g = 0; g < gap; g++, x++) ssd1306_put_column(dev, x, ypos, background, mask);
+        }
+        int index = ssd1306_font_index(font, text[i]);
+        int width = ssd1306_glyph_width(font, index);
+        const uint8_t * columns = ssd1306_glyph_bitmap(font, index);
+        for (int c = 0; c < width; c++, x++) {
+            uint32_t bits = columns[c * bytes];
+            if (bytes > 1) bits |= (uint32_t)columns[c * bytes + 1] << 8;
+            if (invert) bits = ~bits;
+            ssd1306_put_column(dev, x, ypos, bits, mask);
         }
-        _smask = _smask << 1;
-    }
-    for (int i=0;i<8;i++) {
-        image[i] = _image[i];
     }
-    if (flip) ssd1306_flip(image, 8);
-}
 
-void ssd1306_display_rotate_text(SSD1306_t * dev, int seg, const char * text, int text_len, bool invert) {
-    int _text_len = text_len;
-    if (_text_len > 8) _text_len = 8;
-    uint8_t image[8];
-    int _page = dev->_pages-1;
-    for (uint8_t i = 0; i < _text_len; i++) {
-        memcpy(image, font8x8_basic_tr[(uint8_t)text[i]], 8);
-        ssd1306_rotate_image(image, dev->_flip);
-        if (invert) ssd1306_invert(image, 8);
-        ssd1306_display_image(dev, _page, seg, image, 8);
-        _page--;
-        if (_page < 0) return;
+    // Flush the touched rectangle, clipped to the panel
+    int x0 = (xpos < 0) ? 0 : xpos;
+    int x1 = (x > dev->_width) ? dev->_width : x;
+    int p0 = (ypos < 0) ? 0 : ypos / 8;
+    int p1 = (ypos + height - 1) / 8;
+    if (p1 >= dev->_pages) p1 = dev->_pages - 1;
+    for (int page = p0; page <= p1 && x1 > x0; page++) {
+        ssd1306_flush_segs(dev, page, x0, x1 - x0);
     }
+    return x;
 }
 
 void ssd1306_dump(SSD1306_t dev)
@@ -752,25 +1286,46 @@ void ssd1306_dump_page(SSD1306_t * dev, int page, int seg)
 
 #if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
 
-// 1. Implementation of i2c_display_image using i2c_master_transmit
+// 1. Implementation of i2c_display_image, address commands and data in
+// one transaction headed by ssd1306_span_header()
 void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width) {
     if (dev->_i2c_dev_handle == NULL) return;
-
-    // Set Page and Column (Window)
-    uint8_t cmd[] = {
-        0x00,               // CMD Stream
-        0xB0 | page,        // Page Start
-        0x00 | (seg & 0xF), // Lower Col
-        0x10 | ((seg >> 4) & 0xF) // Upper Col
+    if (width > 128) width = 128;
+
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0))
+    uint8_t header[SSD1306_SPAN_HEADER];
+    ssd1306_span_header(dev, page, seg, header);
+    i2c_master_transmit_multi_buffer_info_t buffers[2] = {
+        { .write_buffer = header, .buffer_size = sizeof(header) },
+        { .write_buffer = (uint8_t *)images, .buffer_size = width },
     };
-    i2c_master_transmit(dev->_i2c_dev_handle, cmd, sizeof(cmd), -1);
+    i2c_master_multi_buffer_transmit(dev->_i2c_dev_handle, buffers, 2, -1);
+#else
+    // Only for images that do not live in the internal buffer,
+    // everything drawn by this library goes through i2c_display_buffer()
+    uint8_t data_buf[SSD1306_SPAN_HEADER + 128];
+    ssd1306_span_header(dev, page, seg, data_buf);
+    memcpy(&data_buf[SSD1306_SPAN_HEADER], images, width);
+    i2c_master_transmit(dev->_i2c_dev_handle, data_buf, SSD1306_SPAN_HEADER + width, -1);
+#endif
+}
 
-    // Send Data using VLA (Variable Length Array)
-    // Note: Max width is 128, so stack usage is minimal (~129 bytes)
-    uint8_t data_buf[width + 1];
-    data_buf[0] = 0x40; // DATA Stream
-    memcpy(&data_buf[1], images, width);
-    i2c_master_transmit(dev->_i2c_dev_handle, data_buf, width + 1, -1);
+// 1b. Zero-copy transfer of _segs[seg .. seg+width-1] from the internal buffer
+void i2c_display_buffer(SSD1306_t * dev, int page, int seg, int width) {
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0))
+    i2c_display_image(dev, page, seg, &dev->_page[page]._segs[seg], width);
+#else
+    if (dev->_i2c_dev_handle == NULL) return;
+
+    // The bytes in front of the span are _hdr for seg 0, or previous
+    // segs otherwise: borrow them for the header and put them back.
+    uint8_t *data_buf = &dev->_page[page]._segs[seg] - SSD1306_SPAN_HEADER;
+    uint8_t save[SSD1306_SPAN_HEADER];
+    memcpy(save, data_buf, SSD1306_SPAN_HEADER);
+    ssd1306_span_header(dev, page, seg, data_buf);
+    i2c_master_transmit(dev->_i2c_dev_handle, data_buf, SSD1306_SPAN_HEADER + width, -1);
+    memcpy(data_buf, save, SSD1306_SPAN_HEADER);
+#endif
 }
 
 // 2. Implementation of i2c_contrast
@@ -780,12 +1335,20 @@ void i2c_contrast(SSD1306_t * dev, int contrast) {
     i2c_master_transmit(dev->_i2c_dev_handle, cmd, sizeof(cmd), -1);
 }
 
-// 3. Hardware Scroll stub/implementation
+// 2b. Short command sequences, one transfer
+void i2c_write_commands(SSD1306_t * dev, const uint8_t * commands, int len) {
+    if (dev->_i2c_dev_handle == NULL) return;
+    uint8_t cmd[17];
+    if (len > 16) len = 16;
+    cmd[0] = OLED_CONTROL_BYTE_CMD_STREAM;
+    memcpy(&cmd[1], commands, len);
+    i2c_master_transmit(dev->_i2c_dev_handle, cmd, len + 1, -1);
+}
+
+// 3. Hardware Scroll, built by ssd1306_hardware_scroll()
 void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
     if (dev->_i2c_dev_handle == NULL) return;
-    // Minimal implementation to stop scrolling (safe default)
-    uint8_t cmd[] = { 0x00, 0x2E };
-    i2c_master_transmit(dev->_i2c_dev_handle, cmd, sizeof(cmd), -1);
+    ssd1306_hardware_scroll(dev, scroll);
 }
 
 #endif
\ No newline at end of file
@@ -11,6 +11,27 @@
 #define CONFIG_I2C_PORT 0
 #define CONFIG_SSD1306_ADDR 0x3C
 
+// Frame rate with the init clock (D5h = 80h) and the reset precharge,
+// used to turn scroll step intervals into time. Datasheet typical, +-15%.
+#ifndef SSD1306_FRAME_HZ
+#define SSD1306_FRAME_HZ 105
+#endif
+// Set to 1 when the controller honours the start/end column bytes of the
+// 26h/27h scroll commands (late SSD1306 revisions, SSD1309, SSD1315).
+// Without them a horizontal scroll always moves whole pages.
+#ifndef SSD1306_SCROLL_WINDOW
+#define SSD1306_SCROLL_WINDOW 0
+#endif
+// Drive levels ssd1306_init() sets: precharge 2 + 2 DCLKs (the reset
+// value) and the VCOMH deselect level the bus init sequences have always
+// used (reset is 0x20, 0.77 x Vcc).
+#ifndef SSD1306_PRECHARGE_INIT
+#define SSD1306_PRECHARGE_INIT 0x22
+#endif
+#ifndef SSD1306_VCOMH_INIT
+#define SSD1306_VCOMH_INIT 0x40
+#endif
+
 // Following definitions are bollowed from 
 // http://robotcantalk.blogspot.com/2015/03/interfacing-arduino-with-ssd1306-driven.html
 
@@ -72,6 +93,7 @@ Usage:
 #define OLED_CMD_HORIZONTAL_RIGHT       0x26
 #define OLED_CMD_HORIZONTAL_LEFT        0x27
 #define OLED_CMD_CONTINUOUS_SCROLL      0x29
+#define OLED_CMD_CONTINUOUS_SCROLL_LEFT 0x2A
 #define OLED_CMD_DEACTIVE_SCROLL        0x2E
 #define OLED_CMD_ACTIVE_SCROLL          0x2F
 #define OLED_CMD_VERTICAL               0xA3
@@ -79,6 +101,10 @@ Usage:
 #define I2C_ADDRESS 0x3C
 #define SPI_ADDRESS 0xFF
 
+// Page/column address commands plus data control byte of one I2C span,
+// see ssd1306_span_header()
+#define SSD1306_SPAN_HEADER 7
+
 #define OLED_DRAW_UPPER_RIGHT 0x01
 #define OLED_DRAW_UPPER_LEFT  0x02
 #define OLED_DRAW_LOWER_LEFT  0x04
@@ -95,13 +121,49 @@ typedef enum {
 	SCROLL_STOP = 7
 } ssd1306_scroll_type_t;
 
+// Hardware scroll set up, see ssd1306_hardware_scroll_start()
+typedef struct {
+	int horizontal; // -1 left, 1 right; vertical scrolls always move their pages right or left too
+	int vertical; // Rows per step, positive moves the picture up, 0 for a horizontal scroll
+	int start_page; // Pages that scroll horizontally
+	int end_page;
+	int start_col; // Columns that scroll horizontally, needs SSD1306_SCROLL_WINDOW
+	int end_col;
+	int interval; // Frames per step, rounded to 2, 3, 4, 5, 25, 64, 128 or 256
+	int fixed_rows; // Vertical scroll area: rows kept still at the top
+	int scroll_rows; // and rows that scroll below them, 0 for the rest of the panel
+} ssd1306_hw_scroll_t;
+
+typedef enum {
+	SSD1306_ROP_COPY = 0, // Bitmap replaces the destination
+	SSD1306_ROP_OR = 1, // Set pixels are drawn, clear pixels are transparent
+	SSD1306_ROP_AND = 2, // Clear pixels erase, set pixels are transparent
+	SSD1306_ROP_XOR = 3 // Set pixels toggle the destination
+} ssd1306_rop_t;
+
 typedef struct {
 	bool _valid; // Not using it anymore
 	int _segLen; // Not using it anymore
+	int _dirtyStart; // First seg changed since the last commit (deferred mode)
+	int _dirtyEnd; // One past the last changed seg, equal to _dirtyStart when clean
+	uint8_t _hdr[SSD1306_SPAN_HEADER]; // Room for the I2C span header, must stay right in front of _segs
 	uint8_t _segs[128];
 } PAGE_t;
 
+// Brightness ramp of one panel, kept up by ssd1306_fade.c
 typedef struct {
+	struct esp_timer * _timer; // Ramp steps, created on the first fade
+	int _level; // Brightness the panel has now
+	int _from;
+	int _to;
+	int _step; // Steps done in the running ramp
+	bool _active; // A ramp is running
+	bool _offAtEnd; // Ramp of ssd1306_fadeout(), switch off when done
+	bool _off; // Display is off (AEh)
+	int _restore; // Brightness ssd1306_fadein() goes back to
+} ssd1306_fade_state_t;
+
+typedef struct SSD1306_s {
 	int _address;
 	int _width;
 	int _height;
@@ -113,6 +175,13 @@ typedef struct {
 	int _scDirection;
 	PAGE_t _page[8];
 	bool _flip;
+	bool _deferred; // Draw calls only touch _page[], ssd1306_commit() sends them
+	void (*_present)(struct SSD1306_s * dev); // Set while the flush task runs: commits go to it
+	void (*_present_wait)(struct SSD1306_s * dev); // Same, but returns once the panel has the frame
+	int _startLine; // Buffer row shown on the top row of the panel (display start line)
+	uint8_t _precharge; // Precharge periods (D9h) ssd1306_init() set, fades return to it
+	uint8_t _vcomh; // VCOMH deselect level (DBh) ssd1306_init() set, likewise
+	ssd1306_fade_state_t _fade;
 	i2c_port_t _i2c_num;
 	spi_device_handle_t _spi_device_handle;
 #if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
@@ -121,16 +190,38 @@ typedef struct {
 #endif
 } SSD1306_t;
 
+typedef struct {
+	uint8_t first; // First code point in the font
+	uint8_t count; // Number of glyphs
+	uint8_t height; // Glyph height in pixels, 1 to 16
+	uint8_t width; // Glyph width of fixed fonts (offsets == NULL)
+	uint8_t spacing; // Blank columns between two glyphs
+	const uint8_t * bitmap; // Glyph columns, (height+7)/8 bytes each, bit 0 is the top row
+	const uint16_t * offsets; // count+1 column offsets into bitmap, NULL for fixed fonts
+	const uint16_t * kern_pairs; // Sorted (left << 8 | right) code point pairs
+	const int8_t * kern_adjust; // Columns added to the spacing of each pair
+	uint16_t kern_count;
+} ssd1306_font_t;
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+extern const ssd1306_font_t ssd1306_font_8x8;
+extern const ssd1306_font_t ssd1306_font_prop8;
+
 void ssd1306_init(SSD1306_t * dev, int width, int height);
 int ssd1306_get_width(SSD1306_t * dev);
 int ssd1306_get_height(SSD1306_t * dev);
 int ssd1306_get_pages(SSD1306_t * dev);
 void ssd1306_show_buffer(SSD1306_t * dev);
+void ssd1306_set_deferred(SSD1306_t * dev, bool deferred);
+void ssd1306_commit(SSD1306_t * dev);
+void ssd1306_wait(SSD1306_t * dev);
+void ssd1306_span_header(SSD1306_t * dev, int page, int seg, uint8_t * header);
+void ssd1306_flush_task_start(SSD1306_t * dev, int priority);
+void ssd1306_swap_buffers(SSD1306_t * dev);
 void ssd1306_set_buffer(SSD1306_t * dev, const uint8_t * buffer);
 void ssd1306_get_buffer(SSD1306_t * dev, uint8_t * buffer);
 void ssd1306_set_page(SSD1306_t * dev, int page, const uint8_t * buffer);
@@ -140,18 +231,40 @@ void ssd1306_display_text(SSD1306_t * dev, int page, const char * text, int text
 void ssd1306_display_text_box1(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay);
 void ssd1306_display_text_box2(SSD1306_t * dev, int page, int seg, const char * text, int box_width, int text_len, bool invert, int delay);
 void ssd1306_display_text_x3(SSD1306_t * dev, int page, const char * text, int text_len, bool invert);
+void ssd1306_display_text_scaled(SSD1306_t * dev, int page, int seg, const char * text, int text_len, int scale, bool invert);
 void ssd1306_clear_screen(SSD1306_t * dev, bool invert);
 void ssd1306_clear_line(SSD1306_t * dev, int page, bool invert);
 void ssd1306_contrast(SSD1306_t * dev, int contrast);
+void ssd1306_write_commands(SSD1306_t * dev, const uint8_t * commands, int len);
+void ssd1306_brightness(SSD1306_t * dev, int level);
+void ssd1306_fade(SSD1306_t * dev, int level, int duration_ms);
+void ssd1306_fadein(SSD1306_t * dev);
+bool ssd1306_fading(SSD1306_t * dev);
 void ssd1306_software_scroll(SSD1306_t * dev, int start, int end);
 void ssd1306_scroll_text(SSD1306_t * dev, const char * text, int text_len, bool invert);
 void ssd1306_scroll_clear(SSD1306_t * dev);
 void ssd1306_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
+int ssd1306_hardware_scroll_start(SSD1306_t * dev, const ssd1306_hw_scroll_t * scroll);
+void ssd1306_hardware_scroll_stop(SSD1306_t * dev);
 void ssd1306_wrap_arround(SSD1306_t * dev, ssd1306_scroll_type_t scroll, int start, int end, int8_t delay);
+void ssd1306_set_start_line(SSD1306_t * dev, int line);
+void ssd1306_set_display_offset(SSD1306_t * dev, int offset);
+void ssd1306_viewport_scroll(SSD1306_t * dev, int lines);
+int ssd1306_viewport_row(SSD1306_t * dev, int y);
+void ssd1306_console_print(SSD1306_t * dev, const char * text, bool invert, int delay);
 void _ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert);
 void ssd1306_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert);
+void _ssd1306_blit(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, ssd1306_rop_t rop, bool invert);
+void ssd1306_blit(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, ssd1306_rop_t rop, bool invert);
 void _ssd1306_pixel(SSD1306_t * dev, int xpos, int ypos, bool invert);
+void _ssd1306_hline(SSD1306_t * dev, int x1, int x2, int y, bool invert);
+void _ssd1306_vline(SSD1306_t * dev, int x, int y1, int y2, bool invert);
 void _ssd1306_line(SSD1306_t * dev, int x1, int y1, int x2, int y2,  bool invert);
+void _ssd1306_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert);
+void _ssd1306_fill_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert);
+void ssd1306_fill_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert);
+void _ssd1306_round_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, int r, bool invert);
+void _ssd1306_fill_round_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, int r, bool invert);
 void _ssd1306_circle(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert);
 void _ssd1306_disc(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert);
 void _ssd1306_cursor(SSD1306_t * dev, int x0, int y0, int r, bool invert);
@@ -161,7 +274,11 @@ uint8_t ssd1306_copy_bit(uint8_t src, int srcBits, uint8_t dst, int dstBits);
 uint8_t ssd1306_rotate_byte(uint8_t ch1);
 void ssd1306_fadeout(SSD1306_t * dev);
 void ssd1306_rotate_image(uint8_t *image, bool flip);
+void ssd1306_transpose8(uint32_t * hi, uint32_t * lo);
+void ssd1306_vertical_shift(SSD1306_t * dev, int start, int end, int lines, bool wrap);
 void ssd1306_display_rotate_text(SSD1306_t * dev, int seg, const char * text, int text_len, bool invert);
+int ssd1306_draw_string(SSD1306_t * dev, int xpos, int ypos, const ssd1306_font_t * font, const char * text, bool invert);
+int ssd1306_string_width(const ssd1306_font_t * font, const char * text);
 void ssd1306_dump(SSD1306_t dev);
 void ssd1306_dump_page(SSD1306_t * dev, int page, int seg);
 
@@ -169,7 +286,9 @@ void i2c_master_init(SSD1306_t * dev, int16_t sda, int16_t scl, int16_t reset);
 void i2c_device_add(SSD1306_t * dev, i2c_port_t i2c_num, int16_t reset, uint16_t i2c_address);
 void i2c_init(SSD1306_t * dev, int width, int height);
 void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void i2c_display_buffer(SSD1306_t * dev, int page, int seg, int width);
 void i2c_contrast(SSD1306_t * dev, int contrast);
+void i2c_write_commands(SSD1306_t * dev, const uint8_t * commands, int len);
 void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 
 void spi_clock_speed(int speed);
@@ -181,6 +300,7 @@ bool spi_master_write_command(SSD1306_t * dev, uint8_t Command );
 bool spi_master_write_data(SSD1306_t * dev, const uint8_t* Data, size_t DataLength );
 void spi_init(SSD1306_t * dev, int width, int height);
 void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width);
+void spi_display_wait(SSD1306_t * dev);
 void spi_contrast(SSD1306_t * dev, int contrast);
 void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll);
 
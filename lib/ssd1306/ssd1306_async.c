@@ -0,0 +1,143 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "ssd1306.h"
+
+#define TAG "SSD1306"
+
+// Double buffering: the caller renders into its own SSD1306_t (the back
+// buffer) and hands finished frames over with ssd1306_swap_buffers().
+// A low priority task owns the front buffer, diffs it against the newest
+// frame and sends only the changed spans. Frames handed over while a flush
+// is still running overwrite each other, so only the latest one is sent.
+
+static SSD1306_t s_front;       // What the panel shows, only touched by the flush task
+static PAGE_t s_pending[8];     // Latest frame from ssd1306_swap_buffers()
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static bool s_full_refresh;     // Panel content unknown, send every page
+static uint32_t s_presented;    // Frames handed over, under s_lock
+static uint32_t s_flushed;      // The last of them on the panel, under s_lock
+static SemaphoreHandle_t s_flush_done; // Given after each flush
+
+static void ssd1306_flush_task(void * arg)
+{
+    int start[8];
+    int end[8];
+
+    for (;;) {
+        // Several swaps while we were busy collapse into one wake-up
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        uint32_t frame = s_presented;
+        for (int page = 0; page < s_front._pages; page++) {
+            uint8_t * src = s_pending[page]._segs;
+            uint8_t * dst = s_front._page[page]._segs;
+            int lo = 0;
+            int hi = s_front._width;
+            if (!s_full_refresh) {
+                while (lo < hi && src[lo] == dst[lo]) lo++;
+                while (hi > lo && src[hi-1] == dst[hi-1]) hi--;
+            }
+            if (hi > lo) memcpy(&dst[lo], &src[lo], hi - lo);
+            start[page] = lo;
+            end[page] = hi;
+        }
+        s_full_refresh = false;
+        xSemaphoreGive(s_lock);
+
+        // The bus transfer runs without the lock so the renderer never waits on it
+        for (int page = 0; page < s_front._pages; page++) {
+            if (end[page] <= start[page]) continue;
+            ssd1306_display_image(&s_front, page, start[page], &s_front._page[page]._segs[start[page]], end[page] - start[page]);
+        }
+        // Queued SPI transfers read s_front until done, and only then is
+        // the frame on the panel
+        ssd1306_wait(&s_front);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_flushed = frame;
+        xSemaphoreGive(s_lock);
+        xSemaphoreGive(s_flush_done);
+    }
+}
+
+// Hands the frame to the flush task. Every commit of the back buffer
+// comes here while the task runs, the animation steps too.
+static void ssd1306_present(SSD1306_t * dev)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int page = 0; page < dev->_pages; page++) {
+        memcpy(s_pending[page]._segs, dev->_page[page]._segs, sizeof(s_pending[page]._segs));
+    }
+    s_presented++;
+    xSemaphoreGive(s_lock);
+
+    // The flush task diffs whole pages, dirty spans are not needed anymore
+    for (int page = 0; page < dev->_pages; page++) {
+        dev->_page[page]._dirtyStart = dev->_page[page]._dirtyEnd = 0;
+    }
+    xTaskNotifyGive(s_task);
+}
+
+// Hands the frame over and waits until the flush task has sent it, so a
+// command that acts on the panel RAM can follow (hardware scroll, start
+// line). Later frames may have been sent along with it.
+static void ssd1306_present_wait(SSD1306_t * dev)
+{
+    ssd1306_present(dev);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t frame = s_presented;
+    xSemaphoreGive(s_lock);
+    for (;;) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool done = (int32_t)(s_flushed - frame) >= 0;
+        xSemaphoreGive(s_lock);
+        if (done) return;
+        xSemaphoreTake(s_flush_done, portMAX_DELAY);
+    }
+}
+
+void ssd1306_flush_task_start(SSD1306_t * dev, int priority)
+{
+    if (s_task != NULL) return;
+
+    // Same panel and bus handles, but a buffer of its own
+    memcpy(&s_front, dev, sizeof(SSD1306_t));
+    s_front._deferred = false;
+    s_front._present = NULL;
+    s_front._present_wait = NULL;
+    for (int page = 0; page < 8; page++) {
+        s_front._page[page]._dirtyStart = s_front._page[page]._dirtyEnd = 0;
+    }
+    s_full_refresh = true;
+
+    s_lock = xSemaphoreCreateMutex();
+    s_flush_done = xSemaphoreCreateBinary();
+    if (s_lock == NULL || s_flush_done == NULL) {
+        ESP_LOGE(TAG, "flush task mutex create fail");
+        return;
+    }
+    // The back buffer must never write to the bus itself
+    dev->_deferred = true;
+    if (xTaskCreate(ssd1306_flush_task, "ssd1306_flush", 3072, NULL, priority, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "flush task create fail");
+        dev->_deferred = false;
+        s_task = NULL;
+        return;
+    }
+    dev->_present = ssd1306_present;
+    dev->_present_wait = ssd1306_present_wait;
+}
+
+void ssd1306_swap_buffers(SSD1306_t * dev)
+{
+    if (s_task == NULL) {
+        ssd1306_commit(dev);
+        return;
+    }
+    ssd1306_present(dev);
+}
@@ -0,0 +1,165 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "ssd1306.h"
+
+#define TAG "SSD1306"
+
+// Fades work on the panel drive instead of the picture: a ramp is a few
+// contrast writes (81h) from an esp_timer, so a whole fade is a few dozen
+// bytes on the bus and the caller does not wait for it. Contrast 0 still
+// leaves a visible picture, so the bottom of the range also drops the
+// precharge (D9h) and VCOMH (DBh) levels to their lowest settings, and
+// the top brings back the ones ssd1306_init() set.
+//
+// The timer callback runs in the esp_timer task, never from the ISR, and
+// sends one short command transfer per step (3 bytes, 7 when the drive
+// levels change or the panel switches off), so it holds the task for
+// about 100 us at 400 kHz. The ramp state lives in the device.
+
+#define FADE_STEPS 16
+#define FADE_MS 400
+
+#define DIM_LEVEL 16                // Below this the drive voltages go down too
+#define PRECHARGE_DIM 0x11
+#define VCOMH_DIM 0x00
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Add the registers for 'level' to commands, the drive levels only when
+// they change; returns the new length
+static int ssd1306_fade_commands(SSD1306_t * dev, uint8_t * commands, int n, int level, int previous, bool force)
+{
+    commands[n++] = OLED_CMD_SET_CONTRAST; // 81
+    commands[n++] = level;
+    bool dim = (level < DIM_LEVEL);
+    if (force || dim != (previous < DIM_LEVEL)) {
+        commands[n++] = OLED_CMD_SET_PRECHARGE; // D9
+        commands[n++] = dim ? PRECHARGE_DIM : dev->_precharge;
+        commands[n++] = OLED_CMD_SET_VCOMH_DESELCT; // DB
+        commands[n++] = dim ? VCOMH_DIM : dev->_vcomh;
+    }
+    return n;
+}
+
+static void ssd1306_fade_send(SSD1306_t * dev, int level, int previous, bool force)
+{
+    uint8_t commands[6];
+    int n = ssd1306_fade_commands(dev, commands, 0, level, previous, force);
+    ssd1306_write_commands(dev, commands, n);
+}
+
+static void ssd1306_fade_tick(void * arg)
+{
+    SSD1306_t * dev = arg;
+    ssd1306_fade_state_t * fade = &dev->_fade;
+    portENTER_CRITICAL(&s_lock);
+    int previous = fade->_level;
+    fade->_step++;
+    fade->_level = fade->_from + (fade->_to - fade->_from) * fade->_step / FADE_STEPS;
+    int level = fade->_level;
+    bool done = (fade->_step >= FADE_STEPS);
+    bool off = done && fade->_offAtEnd;
+    if (off) fade->_off = true;
+    if (done) fade->_active = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    // Everything for this step in one transfer
+    uint8_t commands[7];
+    int n = 0;
+    if (level != previous) n = ssd1306_fade_commands(dev, commands, n, level, previous, false);
+    if (off) commands[n++] = OLED_CMD_DISPLAY_OFF; // AE
+    if (n) ssd1306_write_commands(dev, commands, n);
+    if (done) esp_timer_stop(fade->_timer);
+}
+
+static void ssd1306_fade_stop(SSD1306_t * dev)
+{
+    if (dev->_fade._timer) esp_timer_stop(dev->_fade._timer);
+    dev->_fade._active = false;
+}
+
+// Ramp from the current brightness to 'level', returns immediately
+static void ssd1306_fade_start(SSD1306_t * dev, int level, int duration_ms, bool off_at_end)
+{
+    ssd1306_fade_state_t * fade = &dev->_fade;
+    if (fade->_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = ssd1306_fade_tick,
+            .arg = dev,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "ssd1306_fade",
+            .skip_unhandled_events = true,
+        };
+        if (esp_timer_create(&args, &fade->_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not create the fade timer");
+            fade->_timer = NULL;
+            return;
+        }
+    }
+    esp_timer_stop(fade->_timer);
+
+    if (level < 0) level = 0;
+    if (level > 255) level = 255;
+    portENTER_CRITICAL(&s_lock);
+    fade->_from = fade->_level;
+    fade->_to = level;
+    fade->_step = 0;
+    fade->_active = true;
+    fade->_offAtEnd = off_at_end;
+    portEXIT_CRITICAL(&s_lock);
+
+    int period_us = duration_ms * 1000 / FADE_STEPS;
+    if (period_us < 1000) period_us = 1000;
+    esp_timer_start_periodic(fade->_timer, period_us);
+}
+
+void ssd1306_brightness(SSD1306_t * dev, int level)
+{
+    ssd1306_fade_stop(dev);
+    if (level < 0) level = 0;
+    if (level > 255) level = 255;
+    portENTER_CRITICAL(&s_lock);
+    dev->_fade._level = level;
+    portEXIT_CRITICAL(&s_lock);
+    ssd1306_fade_send(dev, level, level, true);
+}
+
+void ssd1306_fade(SSD1306_t * dev, int level, int duration_ms)
+{
+    ssd1306_fade_start(dev, level, duration_ms, false);
+}
+
+// The picture stays in the panel RAM, ssd1306_fadein() brings it back
+void ssd1306_fadeout(SSD1306_t * dev)
+{
+    ssd1306_fade_state_t * fade = &dev->_fade;
+    // A second fadeout must not remember the half dimmed level
+    bool fading_out = fade->_offAtEnd && fade->_active;
+    if (!fade->_off && !fading_out) fade->_restore = fade->_level;
+    ssd1306_fade_start(dev, 0, FADE_MS, true);
+}
+
+void ssd1306_fadein(SSD1306_t * dev)
+{
+    ssd1306_fade_state_t * fade = &dev->_fade;
+    if (fade->_off) {
+        // Switch on dark, the ramp does the rest
+        ssd1306_fade_stop(dev);
+        fade->_level = 0;
+        uint8_t commands[7];
+        int n = ssd1306_fade_commands(dev, commands, 0, 0, 0, true);
+        commands[n++] = OLED_CMD_DISPLAY_ON; // AF
+        ssd1306_write_commands(dev, commands, n);
+        fade->_off = false;
+    }
+    ssd1306_fade_start(dev, fade->_restore, FADE_MS, false);
+}
+
+bool ssd1306_fading(SSD1306_t * dev)
+{
+    return dev->_fade._timer != NULL && esp_timer_is_active(dev->_fade._timer);
+}
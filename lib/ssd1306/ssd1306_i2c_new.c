@@ -156,46 +156,59 @@ void i2c_init(SSD1306_t * dev, int width, int height) {
 }
 
 
+// Address commands and data go out in one transaction, headed by
+// ssd1306_span_header(). Before multi-buffer transmit (IDF 5.4) the header
+// has to sit in front of the data in memory.
 void i2c_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * images, int width) {
 	if (page >= dev->_pages) return;
 	if (seg >= dev->_width) return;
+	if (width > 128) width = 128;
 
-	int _seg = seg + CONFIG_OFFSETX;
-	uint8_t columLow = _seg & 0x0F;
-	uint8_t columHigh = (_seg >> 4) & 0x0F;
-
-	int _page = page;
-	if (dev->_flip) {
-		_page = (dev->_pages - page) - 1;
-	}
-
-	uint8_t *out_buf;
-	out_buf = malloc(width < 4 ? 4 : width + 1);
-	if (out_buf == NULL) {
-		ESP_LOGE(TAG, "malloc fail");
+	esp_err_t res;
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0))
+	uint8_t header[SSD1306_SPAN_HEADER];
+	ssd1306_span_header(dev, page, seg, header);
+	i2c_master_transmit_multi_buffer_info_t buffers[2] = {
+		{ .write_buffer = header, .buffer_size = sizeof(header) },
+		{ .write_buffer = (uint8_t *)images, .buffer_size = width },
+	};
+	res = i2c_master_multi_buffer_transmit(dev->_i2c_dev_handle, buffers, 2, I2C_TICKS_TO_WAIT);
+#else
+	// Spans of the internal buffer can go out without a copy
+	if (images == &dev->_page[page]._segs[seg]) {
+		i2c_display_buffer(dev, page, seg, width);
 		return;
 	}
-	int out_index = 0;
-	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM;
-	// Set Lower Column Start Address for Page Addressing Mode
-	out_buf[out_index++] = (0x00 + columLow);
-	// Set Higher Column Start Address for Page Addressing Mode
-	out_buf[out_index++] = (0x10 + columHigh);
-	// Set Page Start Address for Page Addressing Mode
-	out_buf[out_index++] = 0xB0 | _page;
 
-	esp_err_t res;
-	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index, I2C_TICKS_TO_WAIT);
+	uint8_t out_buf[SSD1306_SPAN_HEADER + 128];
+	ssd1306_span_header(dev, page, seg, out_buf);
+	memcpy(&out_buf[SSD1306_SPAN_HEADER], images, width);
+	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, SSD1306_SPAN_HEADER + width, I2C_TICKS_TO_WAIT);
+#endif
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
+}
 
-	out_buf[0] = OLED_CONTROL_BYTE_DATA_STREAM;
-	memcpy(&out_buf[1], images, width);
+void i2c_display_buffer(SSD1306_t * dev, int page, int seg, int width) {
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0))
+	i2c_display_image(dev, page, seg, &dev->_page[page]._segs[seg], width);
+#else
+	if (page >= dev->_pages) return;
+	if (seg >= dev->_width) return;
 
-	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, width + 1, I2C_TICKS_TO_WAIT);
+	// The bytes in front of the span are _hdr for seg 0, or previous
+	// segs otherwise: borrow them for the header and put them back.
+	uint8_t *out_buf = &dev->_page[page]._segs[seg] - SSD1306_SPAN_HEADER;
+	uint8_t save[SSD1306_SPAN_HEADER];
+	memcpy(save, out_buf, SSD1306_SPAN_HEADER);
+	ssd1306_span_header(dev, page, seg, out_buf);
+
+	esp_err_t res;
+	res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, SSD1306_SPAN_HEADER + width, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
-	free(out_buf);
+	memcpy(out_buf, save, SSD1306_SPAN_HEADER);
+#endif
 }
 
 void i2c_contrast(SSD1306_t * dev, int contrast) {
@@ -214,78 +227,20 @@ void i2c_contrast(SSD1306_t * dev, int contrast) {
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
 }
 
+void i2c_write_commands(SSD1306_t * dev, const uint8_t * commands, int len) {
+	uint8_t out_buf[17];
+	if (len > 16) len = 16;
+	out_buf[0] = OLED_CONTROL_BYTE_CMD_STREAM; // 00
+	memcpy(&out_buf[1], commands, len);
 
-void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
-	uint8_t out_buf[11];
-	int out_index = 0;
-	out_buf[out_index++] = OLED_CONTROL_BYTE_CMD_STREAM; // 00
-
-	if (scroll == SCROLL_RIGHT) {
-		out_buf[out_index++] = OLED_CMD_HORIZONTAL_RIGHT; // 26
-		out_buf[out_index++] = 0x00; // Dummy byte
-		out_buf[out_index++] = 0x00; // Define start page address
-		out_buf[out_index++] = 0x07; // Frame frequency
-		out_buf[out_index++] = 0x07; // Define end page address
-		out_buf[out_index++] = 0x00; //
-		out_buf[out_index++] = 0xFF; //
-		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL; // 2F
-	} 
-
-	if (scroll == SCROLL_LEFT) {
-		out_buf[out_index++] = OLED_CMD_HORIZONTAL_LEFT; // 27
-		out_buf[out_index++] = 0x00; // Dummy byte
-		out_buf[out_index++] = 0x00; // Define start page address
-		out_buf[out_index++] = 0x07; // Frame frequency
-		out_buf[out_index++] = 0x07; // Define end page address
-		out_buf[out_index++] = 0x00; //
-		out_buf[out_index++] = 0xFF; //
-		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL; // 2F
-	} 
-
-	if (scroll == SCROLL_DOWN) {
-		out_buf[out_index++] = OLED_CMD_CONTINUOUS_SCROLL; // 29
-		out_buf[out_index++] = 0x00; // Dummy byte
-		out_buf[out_index++] = 0x00; // Define start page address
-		out_buf[out_index++] = 0x07; // Frame frequency
-		//out_buf[out_index++] = 0x01; // Define end page address
-		out_buf[out_index++] = 0x00; // Define end page address
-		out_buf[out_index++] = 0x3F; // Vertical scrolling offset
-
-		out_buf[out_index++] = OLED_CMD_VERTICAL; // A3
-		out_buf[out_index++] = 0x00;
-		if (dev->_height == 64)
-		//out_buf[out_index++] = 0x7F;
-		out_buf[out_index++] = 0x40;
-		if (dev->_height == 32)
-		out_buf[out_index++] = 0x20;
-		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL; // 2F
-	}
-
-	if (scroll == SCROLL_UP) {
-		out_buf[out_index++] = OLED_CMD_CONTINUOUS_SCROLL; // 29
-		out_buf[out_index++] = 0x00; // Dummy byte
-		out_buf[out_index++] = 0x00; // Define start page address
-		out_buf[out_index++] = 0x07; // Frame frequency
-		//out_buf[out_index++] = 0x01; // Define end page address
-		out_buf[out_index++] = 0x00; // Define end page address
-		out_buf[out_index++] = 0x01; // Vertical scrolling offset
-
-		out_buf[out_index++] = OLED_CMD_VERTICAL; // A3
-		out_buf[out_index++] = 0x00;
-		if (dev->_height == 64)
-		//out_buf[out_index++] = 0x7F;
-		out_buf[out_index++] = 0x40;
-		if (dev->_height == 32)
-		out_buf[out_index++] = 0x20;
-		out_buf[out_index++] = OLED_CMD_ACTIVE_SCROLL; // 2F
-	}
-
-	if (scroll == SCROLL_STOP) {
-		out_buf[out_index++] = OLED_CMD_DEACTIVE_SCROLL; // 2E
-	}
-
-	esp_err_t res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, out_index, I2C_TICKS_TO_WAIT);
+	esp_err_t res = i2c_master_transmit(dev->_i2c_dev_handle, out_buf, len + 1, I2C_TICKS_TO_WAIT);
 	if (res != ESP_OK)
 		ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d (%s)", dev->_address, dev->_i2c_num, res, esp_err_to_name(res));
 }
 
+
+// Built by ssd1306_hardware_scroll(), which sends it with i2c_write_commands()
+void i2c_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll) {
+	ssd1306_hardware_scroll(dev, scroll);
+}
+
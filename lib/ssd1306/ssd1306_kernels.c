@@ -0,0 +1,170 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "ssd1306.h"
+
+// Framebuffer kernels. Everything here works on 32-bit words (four
+// segs, or a whole 8x8 block in two words) instead of single bits.
+
+// Bytes in front of the first word boundary of buf. The words themselves
+// go through memcpy, which keeps the access legal for any buffer type and
+// compiles to a single load and store once aligned.
+static size_t ssd1306_head_len(const uint8_t *buf, size_t blen)
+{
+    size_t head = (4 - ((uintptr_t)buf & 3)) & 3;
+    return (head > blen) ? blen : head;
+}
+
+// Reverse the bit order inside each byte of a word, bytes stay in place
+static inline uint32_t ssd1306_reverse_bytes32(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+    return x;
+}
+
+void ssd1306_invert(uint8_t *buf, size_t blen)
+{
+    size_t head = ssd1306_head_len(buf, blen);
+    size_t i = 0;
+    for (; i < head; i++) buf[i] = ~buf[i];
+    for (; i + 4 <= blen; i += 4) {
+        uint32_t word;
+        memcpy(&word, &buf[i], 4);
+        word = ~word;
+        memcpy(&buf[i], &word, 4);
+    }
+    for (; i < blen; i++) buf[i] = ~buf[i];
+}
+
+void ssd1306_flip(uint8_t *buf, size_t blen)
+{
+    size_t head = ssd1306_head_len(buf, blen);
+    size_t i = 0;
+    for (; i < head; i++) buf[i] = ssd1306_rotate_byte(buf[i]);
+    for (; i + 4 <= blen; i += 4) {
+        uint32_t word;
+        memcpy(&word, &buf[i], 4);
+        word = ssd1306_reverse_bytes32(word);
+        memcpy(&buf[i], &word, 4);
+    }
+    for (; i < blen; i++) buf[i] = ssd1306_rotate_byte(buf[i]);
+}
+
+uint8_t ssd1306_copy_bit(uint8_t src, int srcBits, uint8_t dst, int dstBits)
+{
+    uint8_t smask = 0x01 << srcBits;
+    uint8_t dmask = 0x01 << dstBits;
+    uint8_t _src = src & smask;
+    uint8_t _dst;
+    if (_src != 0) {
+        _dst = dst | dmask;
+    } else {
+        _dst = dst & ~(dmask);
+    }
+    return _dst;
+}
+
+uint8_t ssd1306_rotate_byte(uint8_t ch1) {
+    uint8_t ch2 = ch1;
+    ch2 = ((ch2 >> 1) & 0x55) | ((ch2 & 0x55) << 1);
+    ch2 = ((ch2 >> 2) & 0x33) | ((ch2 & 0x33) << 2);
+    ch2 = (ch2 >> 4) | (ch2 << 4);
+    return ch2;
+}
+
+// Transpose an 8x8 bit block held in two words, Hacker's Delight style.
+// In: one byte per row, most significant bit is the leftmost pixel, row 7
+// in the top byte of hi and row 0 in the bottom byte of lo.
+// Out: one byte per column (leftmost column in the top byte of hi),
+// bit n is row n, which is the GDDRAM layout of a page.
+void ssd1306_transpose8(uint32_t * hi, uint32_t * lo)
+{
+    uint32_t x = *hi;
+    uint32_t y = *lo;
+    uint32_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA; x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00AA00AA; y = y ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC; x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000CCCC; y = y ^ t ^ (t << 14);
+    t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+    y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+    *hi = t;
+    *lo = y;
+}
+
+void ssd1306_rotate_image(uint8_t *image, bool flip) {
+    // Feeding the segs in reverse row order makes the transpose come out
+    // as image[i] bit (7-j) = old image[j] bit i, i.e. a 90 degree turn
+    uint32_t hi = ((uint32_t)image[0] << 24) | (image[1] << 16) | (image[2] << 8) | image[3];
+    uint32_t lo = ((uint32_t)image[4] << 24) | (image[5] << 16) | (image[6] << 8) | image[7];
+    ssd1306_transpose8(&hi, &lo);
+    for (int i = 0; i < 4; i++) {
+        image[i] = lo >> (8 * i);
+        image[i+4] = hi >> (8 * i);
+    }
+    if (flip) ssd1306_flip(image, 8);
+}
+
+// Shift the segs start..end of all pages vertically by 'lines' rows,
+// positive moves the picture down. Four segs are handled at once: a shift
+// by 8*q+b rows is a page offset q plus a per-byte shift by b that pulls
+// the spilled bits in from the neighbouring page. With wrap, rows pushed
+// out come back in on the other side, otherwise the exposed rows are
+// cleared.
+void ssd1306_vertical_shift(SSD1306_t * dev, int start, int end, int lines, bool wrap)
+{
+    int pages = dev->_pages;
+    int rows = pages * 8;
+    bool flip = dev->_flip;
+    if (start < 0) start = 0;
+    if (end >= dev->_width) end = dev->_width - 1;
+    if (wrap) {
+        lines %= rows;
+        if (lines < 0) lines += rows;
+        if (lines == 0) return;
+    } else if (lines >= rows || lines <= -rows) {
+        for (int page = 0; page < pages; page++)
+            memset(&dev->_page[page]._segs[start], 0, end - start + 1);
+        return;
+    }
+    int q = (lines >= 0) ? lines / 8 : -((7 - lines) / 8);
+    int b = lines - q * 8;
+    uint32_t hi_mask = 0x01010101u * (uint8_t)(0xFF << b);
+    uint32_t lo_mask = ~hi_mask;
+
+    // Source pages for the low and the spilled bits, src[8] is blank
+    uint8_t from0[8], from1[8];
+    for (int page = 0; page < pages; page++) {
+        int p0 = page - q;
+        int p1 = p0 - 1;
+        if (wrap) {
+            p0 = (p0 + pages) % pages;
+            p1 = (p1 + pages) % pages;
+        }
+        from0[page] = (p0 >= 0 && p0 < pages) ? p0 : 8;
+        from1[page] = (b != 0 && p1 >= 0 && p1 < pages) ? p1 : 8;
+    }
+
+    for (int seg = start; seg <= end; seg += 4) {
+        int n = end - seg + 1;
+        if (n > 4) n = 4;
+        uint32_t src[9];
+        src[8] = 0;
+        for (int page = 0; page < pages; page++) {
+            src[page] = 0;
+            if (n == 4) memcpy(&src[page], &dev->_page[page]._segs[seg], 4);
+            else memcpy(&src[page], &dev->_page[page]._segs[seg], n);
+            if (flip) src[page] = ssd1306_reverse_bytes32(src[page]);
+        }
+        for (int page = 0; page < pages; page++) {
+            uint32_t w0 = src[from0[page]];
+            uint32_t w1 = src[from1[page]];
+            uint32_t wk = ((w0 << b) & hi_mask) | ((w1 >> (8 - b)) & lo_mask);
+            if (flip) wk = ssd1306_reverse_bytes32(wk);
+            if (n == 4) memcpy(&dev->_page[page]._segs[seg], &wk, 4);
+            else memcpy(&dev->_page[page]._segs[seg], &wk, n);
+        }
+    }
+}
@@ -2,9 +2,11 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 
 #include "ssd1306.h"
 
@@ -20,10 +22,34 @@
 
 #define SPI_COMMAND_MODE 0
 #define SPI_DATA_MODE 1
-#define SPI_DEFAULT_FREQUENCY 1000000; // 1MHz
+#define SPI_DEFAULT_FREQUENCY 10000000 // 10MHz, the SSD1306 serial clock cycle is 100ns min.
+// Transactions in flight: address and data for every page of a frame
+#define SPI_QUEUE_SIZE 16
 
 int clock_speed_hz = SPI_DEFAULT_FREQUENCY;
 
+// Transfers are queued and go out by DMA while the caller carries on.
+// Every transaction carries its DC level (and the DC pin) in t->user and
+// the pre-transfer callback sets the pin, so commands and data can sit in
+// the same queue. The descriptors are a ring: a slot is reused only after
+// its result has been collected.
+// The lock keeps the ring consistent when the flush task and the fade
+// timer both talk to the panel.
+static spi_transaction_t s_trans[SPI_QUEUE_SIZE];
+static int s_trans_next;
+static int s_trans_inflight;
+static SemaphoreHandle_t s_trans_lock;
+
+#define SPI_DC_VALID 0x100
+#define SPI_DC_USER(dc, mode) ((void *)(intptr_t)(SPI_DC_VALID | ((dc) << 1) | (mode)))
+
+static void IRAM_ATTR spi_pre_transfer_callback(spi_transaction_t * t)
+{
+	int user = (int)(intptr_t)t->user;
+	// Raw transfers from spi_master_write_byte() leave DC alone
+	if (user & SPI_DC_VALID) gpio_set_level((user >> 1) & 0x7F, user & 1);
+}
+
 void spi_clock_speed(int speed) {
 	ESP_LOGI(TAG, "SPI clock speed=%d MHz", speed/1000000);
 	clock_speed_hz = speed;
@@ -69,13 +95,15 @@ void spi_master_init(SSD1306_t * dev, int16_t mosi, int16_t sclk, int16_t cs, in
 	//devcfg.clock_speed_hz = SPI_DEFAULT_FREQUENCY;
 	devcfg.clock_speed_hz = clock_speed_hz;
 	devcfg.spics_io_num = cs;
-	devcfg.queue_size = 1;
+	devcfg.queue_size = SPI_QUEUE_SIZE;
+	devcfg.pre_cb = spi_pre_transfer_callback;
 
 	spi_device_handle_t spi_device_handle;
 	ret = spi_bus_add_device( HOST_ID, &devcfg, &spi_device_handle);
 	ESP_LOGI(TAG, "spi_bus_add_device=%d",ret);
 	assert(ret==ESP_OK);
 
+	if (s_trans_lock == NULL) s_trans_lock = xSemaphoreCreateRecursiveMutex();
 	dev->_dc = dc;
 	dev->_address = SPI_ADDRESS;
 	dev->_flip = false;
@@ -125,13 +153,15 @@ void spi_device_add(SSD1306_t * dev, int16_t cs, int16_t dc, int16_t reset)
 	//devcfg.clock_speed_hz = SPI_DEFAULT_FREQUENCY;
 	devcfg.clock_speed_hz = clock_speed_hz;
 	devcfg.spics_io_num = cs;
-	devcfg.queue_size = 1;
+	devcfg.queue_size = SPI_QUEUE_SIZE;
+	devcfg.pre_cb = spi_pre_transfer_callback;
 
 	spi_device_handle_t spi_device_handle;
 	ret = spi_bus_add_device( HOST_ID, &devcfg, &spi_device_handle);
 	ESP_LOGI(TAG, "spi_bus_add_device=%d",ret);
 	assert(ret==ESP_OK);
 
+	if (s_trans_lock == NULL) s_trans_lock = xSemaphoreCreateRecursiveMutex();
 	dev->_dc = dc;
 	dev->_address = SPI_ADDRESS;
 	dev->_flip = false;
@@ -139,37 +169,96 @@ void spi_device_add(SSD1306_t * dev, int16_t cs, int16_t dc, int16_t reset)
 }
 
 
+// Collect the results of everything queued so far
+void spi_display_wait(SSD1306_t * dev)
+{
+	spi_transaction_t * t;
+	xSemaphoreTakeRecursive(s_trans_lock, portMAX_DELAY);
+	while (s_trans_inflight > 0) {
+		spi_device_get_trans_result(dev->_spi_device_handle, &t, portMAX_DELAY);
+		s_trans_inflight--;
+	}
+	xSemaphoreGiveRecursive(s_trans_lock);
+}
+
+// Queue one transfer. Up to 4 bytes travel inside the descriptor, longer
+// data is read by DMA later and has to stay put until it has been sent.
+static void spi_queue(SSD1306_t * dev, int mode, const uint8_t * Data, size_t DataLength)
+{
+	if (DataLength == 0) return;
+	if (s_trans_inflight == SPI_QUEUE_SIZE) {
+		spi_transaction_t * done;
+		spi_device_get_trans_result(dev->_spi_device_handle, &done, portMAX_DELAY);
+		s_trans_inflight--;
+	}
+	spi_transaction_t * t = &s_trans[s_trans_next];
+	s_trans_next = (s_trans_next + 1) % SPI_QUEUE_SIZE;
+	memset(t, 0, sizeof(spi_transaction_t));
+	t->length = DataLength * 8;
+	t->user = SPI_DC_USER(dev->_dc, mode);
+	if (DataLength <= 4) {
+		t->flags = SPI_TRANS_USE_TXDATA;
+		memcpy(t->tx_data, Data, DataLength);
+	} else {
+		t->tx_buffer = Data;
+	}
+	spi_device_queue_trans(dev->_spi_device_handle, t, portMAX_DELAY);
+	s_trans_inflight++;
+}
+
+// Data in the internal buffer may stay in the queue, anything else
+// (stack buffers of the caller) has to be sent before we return
+static bool spi_in_buffer(SSD1306_t * dev, const uint8_t * Data)
+{
+	return (Data >= dev->_page[0]._segs && Data < (const uint8_t *)&dev->_page[8]);
+}
+
+static bool spi_master_write(SSD1306_t * dev, int mode, const uint8_t* Data, size_t DataLength )
+{
+	xSemaphoreTakeRecursive( s_trans_lock, portMAX_DELAY );
+	spi_queue( dev, mode, Data, DataLength );
+	if ( DataLength > 4 && !spi_in_buffer( dev, Data ) ) spi_display_wait( dev );
+	xSemaphoreGiveRecursive( s_trans_lock );
+	return true;
+}
+
+// Blocking raw transfer, DC as it is. Drains the queue first, the driver
+// hands back results in order and must not see a foreign one. Holds the
+// queue lock like spi_display_wait(), so no transfer is queued meanwhile.
 bool spi_master_write_byte(const spi_device_handle_t SPIHandle, const uint8_t* Data, size_t DataLength )
 {
 	spi_transaction_t SPITransaction;
+	spi_transaction_t * t;
 
+	xSemaphoreTakeRecursive( s_trans_lock, portMAX_DELAY );
+	while ( s_trans_inflight > 0 ) {
+		spi_device_get_trans_result( SPIHandle, &t, portMAX_DELAY );
+		s_trans_inflight--;
+	}
 	if ( DataLength > 0 ) {
 		memset( &SPITransaction, 0, sizeof( spi_transaction_t ) );
 		SPITransaction.length = DataLength * 8;
 		SPITransaction.tx_buffer = Data;
 		spi_device_transmit( SPIHandle, &SPITransaction );
 	}
+	xSemaphoreGiveRecursive( s_trans_lock );
 
 	return true;
 }
 
 bool spi_master_write_commands(SSD1306_t * dev, const uint8_t * Commands, size_t DataLength )
 {
-	gpio_set_level( dev->_dc, SPI_COMMAND_MODE );
-	return spi_master_write_byte( dev->_spi_device_handle, Commands, DataLength );
+	return spi_master_write( dev, SPI_COMMAND_MODE, Commands, DataLength );
 }
 
 bool spi_master_write_command(SSD1306_t * dev, uint8_t Command )
 {
-	static uint8_t CommandByte = 0;
-	CommandByte = Command;
-	return spi_master_write_commands( dev, &CommandByte, 1 );
+	return spi_master_write_commands( dev, &Command, 1 );
 }
 
 bool spi_master_write_data(SSD1306_t * dev, const uint8_t* Data, size_t DataLength )
 {
-	gpio_set_level( dev->_dc, SPI_DATA_MODE );
-	return spi_master_write_byte( dev->_spi_device_handle, Data, DataLength );
+	return spi_master_write( dev, SPI_DATA_MODE, Data, DataLength );
 }
 
 
@@ -180,42 +269,44 @@ void spi_init(SSD1306_t * dev, int width, int height)
 	dev->_pages = 8;
 	if (dev->_height == 32) dev->_pages = 4;
 
-	spi_master_write_command(dev, OLED_CMD_DISPLAY_OFF);			// AE
-	spi_master_write_command(dev, OLED_CMD_SET_MUX_RATIO);			// A8
-	if (dev->_height == 64) spi_master_write_command(dev, 0x3F);
-	if (dev->_height == 32) spi_master_write_command(dev, 0x1F);
-	spi_master_write_command(dev, OLED_CMD_SET_DISPLAY_OFFSET);		// D3
-	spi_master_write_command(dev, 0x00);
-	spi_master_write_command(dev, OLED_CONTROL_BYTE_DATA_STREAM);	// 40
+	// The whole sequence goes out as one transfer
+	uint8_t commands[32];
+	int n = 0;
+	commands[n++] = OLED_CMD_DISPLAY_OFF;			// AE
+	commands[n++] = OLED_CMD_SET_MUX_RATIO;			// A8
+	if (dev->_height == 64) commands[n++] = 0x3F;
+	if (dev->_height == 32) commands[n++] = 0x1F;
+	commands[n++] = OLED_CMD_SET_DISPLAY_OFFSET;	// D3
+	commands[n++] = 0x00;
+	commands[n++] = OLED_CONTROL_BYTE_DATA_STREAM;	// 40
 	if (dev->_flip) {
-		spi_master_write_command(dev, OLED_CMD_SET_SEGMENT_REMAP_0);	// A0
+		commands[n++] = OLED_CMD_SET_SEGMENT_REMAP_0;	// A0
 	} else {
-		spi_master_write_command(dev, OLED_CMD_SET_SEGMENT_REMAP_1);	// A1
+		commands[n++] = OLED_CMD_SET_SEGMENT_REMAP_1;	// A1
 	}
-	//spi_master_write_command(dev, OLED_CMD_SET_SEGMENT_REMAP);		// A1
-	spi_master_write_command(dev, OLED_CMD_SET_COM_SCAN_MODE);		// C8
-	spi_master_write_command(dev, OLED_CMD_SET_DISPLAY_CLK_DIV);	// D5
-	spi_master_write_command(dev, 0x80);
-	spi_master_write_command(dev, OLED_CMD_SET_COM_PIN_MAP);		// DA
-	if (dev->_height == 64) spi_master_write_command(dev, 0x12);
-	if (dev->_height == 32) spi_master_write_command(dev, 0x02);
-	spi_master_write_command(dev, OLED_CMD_SET_CONTRAST);			// 81
-	spi_master_write_command(dev, 0xFF);
-	spi_master_write_command(dev, OLED_CMD_DISPLAY_RAM);			// A4
-	spi_master_write_command(dev, OLED_CMD_SET_VCOMH_DESELCT);		// DB
-	spi_master_write_command(dev, 0x40);
-	spi_master_write_command(dev, OLED_CMD_SET_MEMORY_ADDR_MODE);	// 20
-	//spi_master_write_command(dev, OLED_CMD_SET_HORI_ADDR_MODE);	// 00
-	spi_master_write_command(dev, OLED_CMD_SET_PAGE_ADDR_MODE);		// 02
+	commands[n++] = OLED_CMD_SET_COM_SCAN_MODE;		// C8
+	commands[n++] = OLED_CMD_SET_DISPLAY_CLK_DIV;	// D5
+	commands[n++] = 0x80;
+	commands[n++] = OLED_CMD_SET_COM_PIN_MAP;		// DA
+	if (dev->_height == 64) commands[n++] = 0x12;
+	if (dev->_height == 32) commands[n++] = 0x02;
+	commands[n++] = OLED_CMD_SET_CONTRAST;			// 81
+	commands[n++] = 0xFF;
+	commands[n++] = OLED_CMD_DISPLAY_RAM;			// A4
+	commands[n++] = OLED_CMD_SET_VCOMH_DESELCT;		// DB
+	commands[n++] = 0x40;
+	commands[n++] = OLED_CMD_SET_MEMORY_ADDR_MODE;	// 20
+	commands[n++] = OLED_CMD_SET_PAGE_ADDR_MODE;	// 02
 	// Set Lower Column Start Address for Page Addressing Mode
-	spi_master_write_command(dev, 0x00);
+	commands[n++] = 0x00;
 	// Set Higher Column Start Address for Page Addressing Mode
-	spi_master_write_command(dev, 0x10);
-	spi_master_write_command(dev, OLED_CMD_SET_CHARGE_PUMP);		// 8D
-	spi_master_write_command(dev, 0x14);
-	spi_master_write_command(dev, OLED_CMD_DEACTIVE_SCROLL);		// 2E
-	spi_master_write_command(dev, OLED_CMD_DISPLAY_NORMAL);			// A6
-	spi_master_write_command(dev, OLED_CMD_DISPLAY_ON);				// AF
+	commands[n++] = 0x10;
+	commands[n++] = OLED_CMD_SET_CHARGE_PUMP;		// 8D
+	commands[n++] = 0x14;
+	commands[n++] = OLED_CMD_DEACTIVE_SCROLL;		// 2E
+	commands[n++] = OLED_CMD_DISPLAY_NORMAL;		// A6
+	commands[n++] = OLED_CMD_DISPLAY_ON;			// AF
+	spi_master_write_commands(dev, commands, n);
 }
 
 
@@ -235,10 +326,12 @@ void spi_display_image(SSD1306_t * dev, int page, int seg, const uint8_t * image
 
 	// Set Lower Column Start Address for Page Addressing Mode, Higher Column Start Address for Page Addressing Mode and Page Start Address for Page Addressing Mode
 	uint8_t commands[3] = { 0x00 + columLow, 0x10 + columHigh, 0xB0 | _page };
+	xSemaphoreTakeRecursive(s_trans_lock, portMAX_DELAY);
 	spi_master_write_commands(dev, commands, 3);
 
+	// Spans of the internal buffer stay queued, the caller can go on rendering
 	spi_master_write_data(dev, images, width);
-
+	xSemaphoreGiveRecursive(s_trans_lock);
 }
 
 void spi_contrast(SSD1306_t * dev, int contrast) {
@@ -246,72 +339,12 @@ void spi_contrast(SSD1306_t * dev, int contrast) {
 	if (contrast < 0x0) _contrast = 0;
 	if (contrast > 0xFF) _contrast = 0xFF;
 
-	spi_master_write_command(dev, OLED_CMD_SET_CONTRAST);			// 81
-	spi_master_write_command(dev, _contrast);
+	uint8_t commands[2] = { OLED_CMD_SET_CONTRAST, _contrast };	// 81
+	spi_master_write_commands(dev, commands, 2);
 }
 
+// Built by ssd1306_hardware_scroll(), which sends it with spi_master_write_commands()
 void spi_hardware_scroll(SSD1306_t * dev, ssd1306_scroll_type_t scroll)
 {
-
-	if (scroll == SCROLL_RIGHT) {
-		spi_master_write_command(dev, OLED_CMD_HORIZONTAL_RIGHT);	// 26
-		spi_master_write_command(dev, 0x00); // Dummy byte
-		spi_master_write_command(dev, 0x00); // Define start page address
-		spi_master_write_command(dev, 0x07); // Frame frequency
-		spi_master_write_command(dev, 0x07); // Define end page address
-		spi_master_write_command(dev, 0x00); //
-		spi_master_write_command(dev, 0xFF); //
-		spi_master_write_command(dev, OLED_CMD_ACTIVE_SCROLL);		// 2F
-	} 
-
-	if (scroll == SCROLL_LEFT) {
-		spi_master_write_command(dev, OLED_CMD_HORIZONTAL_LEFT);	// 27
-		spi_master_write_command(dev, 0x00); // Dummy byte
-		spi_master_write_command(dev, 0x00); // Define start page address
-		spi_master_write_command(dev, 0x07); // Frame frequency
-		spi_master_write_command(dev, 0x07); // Define end page address
-		spi_master_write_command(dev, 0x00); //
-		spi_master_write_command(dev, 0xFF); //
-		spi_master_write_command(dev, OLED_CMD_ACTIVE_SCROLL);		// 2F
-	} 
-
-	if (scroll == SCROLL_DOWN) {
-		spi_master_write_command(dev, OLED_CMD_CONTINUOUS_SCROLL);	// 29
-		spi_master_write_command(dev, 0x00); // Dummy byte
-		spi_master_write_command(dev, 0x00); // Define start page address
-		spi_master_write_command(dev, 0x07); // Frame frequency
-		//spi_master_write_command(dev, 0x01); // Define end page address
-		spi_master_write_command(dev, 0x00); // Define end page address
-		spi_master_write_command(dev, 0x3F); // Vertical scrolling offset
-
-		spi_master_write_command(dev, OLED_CMD_VERTICAL);			// A3
-		spi_master_write_command(dev, 0x00);
-		if (dev->_height == 64)
-			spi_master_write_command(dev, 0x40);
-		if (dev->_height == 32)
-			spi_master_write_command(dev, 0x20);
-		spi_master_write_command(dev, OLED_CMD_ACTIVE_SCROLL);		// 2F
-	}
-
-	if (scroll == SCROLL_UP) {
-		spi_master_write_command(dev, OLED_CMD_CONTINUOUS_SCROLL);	// 29
-		spi_master_write_command(dev, 0x00); // Dummy byte
-		spi_master_write_command(dev, 0x00); // Define start page address
-		spi_master_write_command(dev, 0x07); // Frame frequency
-		//spi_master_write_command(dev, 0x01); // Define end page address
-		spi_master_write_command(dev, 0x00); // Define end page address
-		spi_master_write_command(dev, 0x01); // Vertical scrolling offset
-
-		spi_master_write_command(dev, OLED_CMD_VERTICAL);			// A3
-		spi_master_write_command(dev, 0x00);
-		if (dev->_height == 64)
-			spi_master_write_command(dev, 0x40);
-		if (dev->_height == 32)
-			spi_master_write_command(dev, 0x20);
-		spi_master_write_command(dev, OLED_CMD_ACTIVE_SCROLL);		// 2F
-	}
-
-	if (scroll == SCROLL_STOP) {
-		spi_master_write_command(dev, OLED_CMD_DEACTIVE_SCROLL);	// 2E
-	}
+	ssd1306_hardware_scroll(dev, scroll);
 }
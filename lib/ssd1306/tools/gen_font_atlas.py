@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Generate font8x8_scaled.h from font8x8_basic_tr in font8x8_basic.h.
+
+    python3 tools/gen_font_atlas.py > font8x8_scaled.h
+
+Run from lib/ssd1306 whenever font8x8_basic.h changes.
+"""
+import os
+import re
+import sys
+
+FIRST = 0x20
+LAST = 0x7F
+SCALES = (2, 3, 4)
+
+
+def load_font(path):
+    src = open(path).read()
+    body = src[src.index("font8x8_basic_tr[128][8]"):]
+    rows = re.findall(r"\{\s*((?:0x[0-9A-Fa-f]{2}\s*,\s*){7}0x[0-9A-Fa-f]{2})\s*\}", body)
+    font = [[int(v, 16) for v in row.split(",")] for row in rows[:128]]
+    if len(font) != 128:
+        sys.exit("font8x8_basic_tr: expected 128 glyphs, got %d" % len(font))
+    return font
+
+
+def scale_glyph(columns, scale):
+    # Every source bit becomes scale x scale pixels, split into scale pages
+    pages = [[0] * (8 * scale) for _ in range(scale)]
+    for x, col in enumerate(columns):
+        tall = 0
+        for y in range(8):
+            if col & (1 << y):
+                tall |= ((1 << scale) - 1) << (y * scale)
+        for p in range(scale):
+            byte = (tall >> (8 * p)) & 0xFF
+            for r in range(scale):
+                pages[p][x * scale + r] = byte
+    return pages
+
+
+def rotate_glyph(columns):
+    # Same transpose as ssd1306_rotate_image() without flip
+    out = []
+    for i in range(8):
+        v = 0
+        for j in range(8):
+            if columns[j] & (1 << i):
+                v |= 0x80 >> j
+        out.append(v)
+    return out
+
+
+def hexrow(values):
+    return ", ".join("0x%02X" % v for v in values)
+
+
+def label(code):
+    if code == 0x7F:
+        return "U+007F"
+    return "U+%04X (%s)" % (code, chr(code))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    font = load_font(os.path.join(here, "..", "font8x8_basic.h"))
+    out = []
+    out.append("/*")
+    out.append(" * font8x8_scaled.h")
+    out.append(" *")
+    out.append(" * Generated by tools/gen_font_atlas.py from font8x8_basic_tr, do not edit.")
+    out.append(" */")
+    out.append("")
+    out.append("#ifndef MAIN_FONT8X8_SCALED_H_")
+    out.append("#define MAIN_FONT8X8_SCALED_H_")
+    out.append("")
+    out.append("/*")
+    out.append("   Pre-expanded glyphs for U+%04X - U+%04X, in GDDRAM layout." % (FIRST, LAST))
+    out.append("   font8x8_xN_tr[code - 0x%02X][page][seg] holds the N x N scaled glyph," % FIRST)
+    out.append("   one row of 8*N segs for each of the N pages it covers.")
+    out.append("   font8x8_basic_rot[code] is the glyph rotated by 90 degrees.")
+    out.append("*/")
+    out.append("")
+    out.append("#define FONT8X8_SCALED_FIRST 0x%02X" % FIRST)
+    out.append("#define FONT8X8_SCALED_LAST  0x%02X" % LAST)
+    out.append("#define FONT8X8_SCALE_MAX    %d" % max(SCALES))
+    for scale in SCALES:
+        out.append("")
+        out.append("static const uint8_t font8x8_x%d_tr[%d][%d][%d] = {" % (scale, LAST - FIRST + 1, scale, 8 * scale))
+        for code in range(FIRST, LAST + 1):
+            pages = scale_glyph(font[code], scale)
+            out.append("    {   // %s" % label(code))
+            for p in pages:
+                out.append("        { %s }," % hexrow(p))
+            out.append("    },")
+        out.append("};")
+    out.append("")
+    out.append("static const uint8_t font8x8_basic_rot[128][8] = {")
+    for code in range(128):
+        out.append("    { %s },   // U+%04X" % (hexrow(rotate_glyph(font[code])), code))
+    out.append("};")
+    out.append("")
+    out.append("#endif /* MAIN_FONT8X8_SCALED_H_ */")
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
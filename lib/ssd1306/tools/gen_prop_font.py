@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Generate font_prop8.h, a proportional 8 pixel font, from font8x8_basic_tr.
+
+    python3 tools/gen_prop_font.py > font_prop8.h
+
+Run from lib/ssd1306 whenever font8x8_basic.h changes.
+
+Every glyph of U+0020 - U+007E is trimmed to its inked columns (space
+becomes 3 columns wide). A pair is kerned by one column when the last two
+columns of the left glyph and the first two columns of the right glyph
+stay at least two rows apart, so the glyphs can never touch.
+"""
+import os
+
+from gen_font_atlas import hexrow, load_font
+
+FIRST = 0x20
+LAST = 0x7E
+SPACE_WIDTH = 3
+
+
+def trim(columns):
+    inked = [i for i, v in enumerate(columns) if v]
+    if not inked:
+        return [0] * SPACE_WIDTH
+    return columns[inked[0]:inked[-1] + 1]
+
+
+def rows(columns):
+    mask = 0
+    for v in columns:
+        mask |= v
+    return mask
+
+
+def grow(mask, n):
+    for _ in range(n):
+        mask |= (mask << 1) | (mask >> 1)
+    return mask
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    font = load_font(os.path.join(here, "..", "font8x8_basic.h"))
+    glyphs = [trim(font[code]) for code in range(FIRST, LAST + 1)]
+
+    kerning = []
+    for a in range(FIRST + 1, LAST + 1):
+        right = rows(glyphs[a - FIRST][-2:])
+        for b in range(FIRST + 1, LAST + 1):
+            left = rows(glyphs[b - FIRST][:2])
+            if right & grow(left, 2) == 0:
+                kerning.append((a << 8) | b)
+
+    out = []
+    out.append("/*")
+    out.append(" * font_prop8.h")
+    out.append(" *")
+    out.append(" * Generated by tools/gen_prop_font.py from font8x8_basic_tr, do not edit.")
+    out.append(" */")
+    out.append("")
+    out.append("#ifndef MAIN_FONT_PROP8_H_")
+    out.append("#define MAIN_FONT_PROP8_H_")
+    out.append("")
+    out.append("/*")
+    out.append("   Proportional 8 pixel font for U+%04X - U+%04X." % (FIRST, LAST))
+    out.append("   font_prop8_bitmap holds the glyph columns back to back (bit 0 = top row),")
+    out.append("   glyph n spans columns font_prop8_offsets[n] .. font_prop8_offsets[n+1]-1.")
+    out.append("   font_prop8_kern_pairs lists (left << 8 | right) pairs, sorted, that are")
+    out.append("   moved closer by font_prop8_kern_adjust columns.")
+    out.append("*/")
+    out.append("")
+    out.append("#define FONT_PROP8_FIRST 0x%02X" % FIRST)
+    out.append("#define FONT_PROP8_COUNT %d" % len(glyphs))
+    out.append("#define FONT_PROP8_KERN_COUNT %d" % len(kerning))
+    out.append("")
+    out.append("static const uint8_t font_prop8_bitmap[] = {")
+    offsets = [0]
+    for code, columns in zip(range(FIRST, LAST + 1), glyphs):
+        out.append("    %s,   // U+%04X (%s)" % (hexrow(columns), code, chr(code)))
+        offsets.append(offsets[-1] + len(columns))
+    out.append("};")
+    out.append("")
+    out.append("static const uint16_t font_prop8_offsets[%d] = {" % len(offsets))
+    for i in range(0, len(offsets), 12):
+        out.append("    %s," % ", ".join("%d" % v for v in offsets[i:i + 12]))
+    out.append("};")
+    out.append("")
+    out.append("static const uint16_t font_prop8_kern_pairs[%d] = {" % len(kerning))
+    for i in range(0, len(kerning), 8):
+        out.append("    %s," % ", ".join("0x%04X" % v for v in kerning[i:i + 8]))
+    out.append("};")
+    out.append("")
+    out.append("static const int8_t font_prop8_kern_adjust[%d] = {" % len(kerning))
+    for i in range(0, len(kerning), 16):
+        out.append("    %s," % ", ".join("-1" for _ in kerning[i:i + 16]))
+    out.append("};")
+    out.append("")
+    out.append("#endif /* MAIN_FONT_PROP8_H_ */")
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,25 +1,120 @@
 #include "RTC_manager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <stdbool.h>
 #include <string.h>
 #include <sys/time.h>
+#include "clock_manager.h"
+#include "diag_manager.h"
+#include "metrics.h"
+#include "boot_manager.h"
+#include "globals.h"
+
+static const char *TAG = "RTC";
+
+/* DS3231 registers */
+#define RTC_REG_SECONDS     0x00
+#define RTC_REG_CONTROL     0x0E
+#define RTC_REG_STATUS      0x0F
+#define RTC_CONTROL_INTCN   0x04    // Alarm interrupt instead of square wave
+#define RTC_CONTROL_RS      0x18    // RS2:RS1, 00 = 1 Hz
+#define RTC_STATUS_OSF      0x80    // Oscillator stopped, the time is not valid
+#define RTC_MIN_YEAR        2024    // Anything older is an unset clock
+
+/* The RTC task runs once per second, woken by the 1 Hz SQW edge at the
+ * start of each RTC second; it advances the cached clock and wakes the UI.
+ * The edges carry the RTC's own seconds, read from its registers at the
+ * first edge and counted on from there. When no edge comes it falls back
+ * to the system clock's second.
+ *
+ * Discipline of the system clock against the RTC: every period the start
+ * of an RTC second is timed in system time, from the SQW edge or else by
+ * polling the seconds register. The difference is removed by slewing with
+ * adjtime(), so timestamps never step back. The measured drift between
+ * two samples gives the frequency error of the system clock, which is
+ * slewed away in steps between the samples. */
+#define RTC_DISCIPLINE_PERIOD_S     64
+#define RTC_DISCIPLINE_STEPS        64      // Frequency corrections per period
+#define RTC_TASK_PRIORITY           5
+#define RTC_SQW_EDGE                GPIO_INTR_NEGEDGE // Seconds count on the falling edge
+#define RTC_SQW_GRACE_MS            20      // Edge later than the system second
+#define RTC_STEP_US                 1000000 // Larger offsets are stepped
+#define RTC_FREQ_MAX_PPB            500000  // Beyond any crystal, a bad sample
+#define RTC_FREQ_GAIN               8       // 1/8 of each new measurement
+#define RTC_EDGE_WINDOW_US          (2 * portTICK_PERIOD_MS * 1000)
+
+typedef struct {
+    bool have_last;
+    int64_t last_sys_us;    // System time of the last sample
+    int64_t last_offset_us; // System minus RTC time at the last sample
+    int64_t slewed_us;      // Handed to adjtime() since the last sample
+    int32_t freq_ppb;       // Rate of the system clock against the RTC
+    int64_t freq_rem;       // Frequency slew below 1 us still owed, ppb us
+} rtc_discipline_t;
+
+METRIC_GAUGE(s_offset_metric, "rtc.offset_us");
+METRIC_GAUGE(s_freq_metric, "rtc.freq_ppb");
+METRIC_COUNTER(s_step_metric, "rtc.steps");
+METRIC_COUNTER(s_sqw_metric, "rtc.sqw_edges");
+
+static TaskHandle_t s_rtc_task = NULL;
+static portMUX_TYPE s_sqw_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_sqw_timer_us;      // esp_timer time of the last edge
+static int64_t s_anchor_timer_us;   // Same, once its second is known
+static time_t s_anchor_second;
 
 static uint8_t bcd2dec(uint8_t val) { return ((val >> 4) * 10) + (val & 0x0f); }
 static uint8_t dec2bcd(uint8_t val) { return ((val / 10) << 4) + (val % 10); }
 
+static int64_t rtc_sys_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static struct tm rtc_decode(const uint8_t *d) {
+    struct tm tm = {
+        .tm_sec = bcd2dec(d[0]),
+        .tm_min = bcd2dec(d[1]),
+        .tm_hour = bcd2dec(d[2] & 0x3F),
+        .tm_mday = bcd2dec(d[4]),
+        .tm_mon = bcd2dec(d[5] & 0x7F) - 1,
+        .tm_year = bcd2dec(d[6]) + 100,
+        .tm_isdst = -1
+    };
+    return tm;
+}
+
+/* Time and status registers in one read, false when the RTC time is not
+ * valid: the oscillator stopped or the clock was never set */
+static esp_err_t rtc_read(i2c_master_dev_handle_t rtc_handle, struct tm *tm, bool *valid) {
+    uint8_t reg = RTC_REG_SECONDS;
+    uint8_t d[RTC_REG_STATUS + 1];
+    esp_err_t err = i2c_master_transmit_receive(rtc_handle, &reg, 1, d, sizeof(d), -1);
+    if (err != ESP_OK) return err;
+    *tm = rtc_decode(d);
+    *valid = !(d[RTC_REG_STATUS] & RTC_STATUS_OSF) && tm->tm_year + 1900 >= RTC_MIN_YEAR;
+    return ESP_OK;
+}
+
+static esp_err_t rtc_read_seconds(i2c_master_dev_handle_t rtc_handle, uint8_t *sec) {
+    uint8_t reg = RTC_REG_SECONDS;
+    return i2c_master_transmit_receive(rtc_handle, &reg, 1, sec, 1, -1);
+}
+
 void sync_logic(i2c_master_dev_handle_t rtc_handle) {
-    uint8_t reg = 0x00;
-    uint8_t d[7];
+    struct tm tm;
+    bool valid;
     // NEW DRIVER CALL: No I2C_PORT used here
-    if (i2c_master_transmit_receive(rtc_handle, &reg, 1, d, 7, -1) == ESP_OK) {
-        struct tm tm = {
-            .tm_sec = bcd2dec(d[0]),
-            .tm_min = bcd2dec(d[1]),
-            .tm_hour = bcd2dec(d[2] & 0x3F),
-            .tm_mday = bcd2dec(d[4]),
-            .tm_mon = bcd2dec(d[5] & 0x7F) - 1,
-            .tm_year = bcd2dec(d[6]) + 100,
-            .tm_isdst = -1
-        };
+    if (rtc_read(rtc_handle, &tm, &valid) == ESP_OK) {
+        if (!valid) {
+            ESP_LOGW(TAG, "RTC time not valid, system clock left as is");
+            return;
+        }
         time_t t = mktime(&tm);
         struct timeval tv = { .tv_sec = t, .tv_usec = 0 };
         settimeofday(&tv, NULL);
@@ -27,17 +122,283 @@ void sync_logic(i2c_master_dev_handle_t rtc_handle) {
     }
 }
 
-struct tm get_and_return_time(char *buffer, size_t max_len) {
-    time_t now;
-    struct tm timeinfo;
-    
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    
-    // Still fills the buffer if one is provided
-    if (buffer != NULL && max_len > 0) {
-        strftime(buffer, max_len, "%c", &timeinfo);
+esp_err_t rtc_write_time(i2c_master_dev_handle_t rtc_handle) {
+    // An unset system clock fails at once, not after the wait
+    struct timeval tv;
+    struct tm tm;
+    gettimeofday(&tv, NULL);
+    localtime_r(&tv.tv_sec, &tm);
+    if (tm.tm_year + 1900 < RTC_MIN_YEAR) return ESP_ERR_INVALID_STATE;
+
+    // Writing the seconds restarts the RTC second, so wait for a full one.
+    // The delay ends on a tick and can be up to one short of the second:
+    // spin the rest, or the RTC would get the old second, 1 s behind.
+    time_t before = tv.tv_sec;
+    vTaskDelay(pdMS_TO_TICKS((1000000 - tv.tv_usec) / 1000));
+    do {
+        gettimeofday(&tv, NULL);
+    } while (tv.tv_sec <= before);
+    localtime_r(&tv.tv_sec, &tm);
+    uint8_t d[8] = {
+        RTC_REG_SECONDS,
+        dec2bcd(tm.tm_sec), dec2bcd(tm.tm_min), dec2bcd(tm.tm_hour), // 24 hour mode
+        dec2bcd(tm.tm_wday + 1), dec2bcd(tm.tm_mday), dec2bcd(tm.tm_mon + 1),
+        dec2bcd(tm.tm_year - 100),
+    };
+    esp_err_t err = i2c_master_transmit(rtc_handle, d, sizeof(d), -1);
+    if (err != ESP_OK) return err;
+    const uint8_t status[2] = { RTC_REG_STATUS, 0x00 }; // Clears OSF
+    return i2c_master_transmit(rtc_handle, status, sizeof(status), -1);
+}
+
+/* System time at which the RTC seconds register changes. A coarse pass
+ * polls once per tick to find the second, a fine pass then reads back to
+ * back around the next one, so the edge is known to about one I2C read. */
+static bool rtc_find_edge(i2c_master_dev_handle_t rtc_handle, int64_t *edge_us) {
+    uint8_t first, sec;
+    int64_t coarse = 0;
+    if (rtc_read_seconds(rtc_handle, &first) != ESP_OK) return false;
+    for (int i = 0; i <= 1000 / portTICK_PERIOD_MS && !coarse; i++) {
+        vTaskDelay(1);
+        if (rtc_read_seconds(rtc_handle, &sec) != ESP_OK) return false;
+        if (sec != first) coarse = rtc_sys_us();
+    }
+    if (!coarse) return false;
+
+    int64_t wait_us = coarse + 1000000 - RTC_EDGE_WINDOW_US - rtc_sys_us();
+    if (wait_us > 0) vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+    if (rtc_read_seconds(rtc_handle, &first) != ESP_OK) return false;
+    int64_t before = rtc_sys_us();
+    int64_t deadline = before + 3 * RTC_EDGE_WINDOW_US;
+    for (;;) {
+        int64_t start = rtc_sys_us();
+        if (rtc_read_seconds(rtc_handle, &sec) != ESP_OK) return false;
+        int64_t end = rtc_sys_us();
+        if (sec != first) {
+            *edge_us = (before + end) / 2;
+            return true;
+        }
+        if (end > deadline) return false;
+        before = start;
+    }
+}
+
+/* Adds to the slew still pending, adjtime() would drop it otherwise */
+static void rtc_slew(rtc_discipline_t *d, int64_t delta_us) {
+    struct timeval pending;
+    adjtime(NULL, &pending);
+    int64_t total = (int64_t)pending.tv_sec * 1000000 + pending.tv_usec + delta_us;
+    struct timeval tv = { .tv_sec = total / 1000000, .tv_usec = total % 1000000 };
+    if (adjtime(&tv, NULL) == 0) d->slewed_us += delta_us;
+}
+
+/* New sample: offset is system minus RTC time at sys_us, pending_us the
+ * slew adjtime() has not applied yet. Returns the slew that removes the
+ * offset. */
+static int64_t rtc_discipline_update(rtc_discipline_t *d, int64_t sys_us, int64_t offset_us,
+                                     int64_t pending_us) {
+    int64_t applied = d->slewed_us - pending_us;
+    if (d->have_last && sys_us > d->last_sys_us) {
+        int64_t drift = offset_us - d->last_offset_us - applied;
+        int64_t ppb = drift * 1000000000 / (sys_us - d->last_sys_us);
+        if (ppb > -RTC_FREQ_MAX_PPB && ppb < RTC_FREQ_MAX_PPB) {
+            d->freq_ppb += (int32_t)(ppb - d->freq_ppb) / RTC_FREQ_GAIN;
+        }
+    }
+    d->have_last = true;
+    d->last_sys_us = sys_us;
+    d->last_offset_us = offset_us;
+    d->slewed_us = pending_us;
+    return -offset_us - pending_us;
+}
+
+/* One sample: time the RTC second, check its time and slew or step the
+ * system clock to it. sqw_edge_us is the system time of the SQW edge that
+ * just started the second, NULL to find it by polling. An RTC that lost
+ * its time gets the system time; true when it was written. */
+static bool rtc_discipline_sample(i2c_master_dev_handle_t rtc_handle, rtc_discipline_t *d,
+                                  const int64_t *sqw_edge_us) {
+    int64_t edge_us;
+    struct tm tm;
+    bool valid;
+    if (sqw_edge_us) {
+        edge_us = *sqw_edge_us;
+    } else if (!rtc_find_edge(rtc_handle, &edge_us)) {
+        ESP_LOGW(TAG, "RTC read failed");
+        return false;
+    }
+    if (rtc_read(rtc_handle, &tm, &valid) != ESP_OK) {
+        ESP_LOGW(TAG, "RTC read failed");
+        return false;
     }
-    
-    return timeinfo; // Returns the full time structure
-}
\ No newline at end of file
+    if (!valid) {
+        d->have_last = false;
+        esp_err_t err = rtc_write_time(rtc_handle);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "RTC time not valid, set failed: %s", esp_err_to_name(err));
+            return false;
+        }
+        ESP_LOGW(TAG, "RTC time not valid, set from the system clock");
+        return true;
+    }
+
+    int64_t offset_us = edge_us - (int64_t)mktime(&tm) * 1000000;
+    metric_set(&s_offset_metric, (offset_us < INT32_MIN) ? INT32_MIN : (offset_us > INT32_MAX) ? INT32_MAX : offset_us);
+    if (offset_us <= -RTC_STEP_US || offset_us >= RTC_STEP_US) {
+        metric_inc(&s_step_metric);
+        struct timeval zero = { 0 };
+        struct timeval tv;
+        adjtime(&zero, NULL);
+        int64_t now = rtc_sys_us() - offset_us;
+        tv.tv_sec = now / 1000000;
+        tv.tv_usec = now % 1000000;
+        settimeofday(&tv, NULL);
+        clock_resync();
+        d->have_last = false;
+        d->slewed_us = 0;
+        ESP_LOGW(TAG, "System clock stepped by %lld ms", (long long)(-offset_us / 1000));
+        return false;
+    }
+
+    struct timeval pending;
+    adjtime(NULL, &pending);
+    int64_t pending_us = (int64_t)pending.tv_sec * 1000000 + pending.tv_usec;
+    rtc_slew(d, rtc_discipline_update(d, edge_us, offset_us, pending_us));
+    metric_set(&s_freq_metric, d->freq_ppb);
+    ESP_LOGD(TAG, "Offset %lld us, frequency %ld ppb", (long long)offset_us, (long)d->freq_ppb);
+    return false;
+}
+
+static void IRAM_ATTR rtc_sqw_isr(void *arg) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&s_sqw_lock);
+    s_sqw_timer_us = now;
+    portEXIT_CRITICAL_ISR(&s_sqw_lock);
+    BaseType_t woken = pdFALSE;
+    if (s_rtc_task) vTaskNotifyGiveFromISR(s_rtc_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/* 1 Hz on the SQW pin, open drain, pulled up here */
+static esp_err_t rtc_sqw_init(i2c_master_dev_handle_t rtc_handle) {
+    uint8_t reg = RTC_REG_CONTROL;
+    uint8_t control;
+    esp_err_t err = i2c_master_transmit_receive(rtc_handle, &reg, 1, &control, 1, -1);
+    if (err != ESP_OK) return err;
+    const uint8_t d[2] = { RTC_REG_CONTROL, control & ~(RTC_CONTROL_INTCN | RTC_CONTROL_RS) };
+    err = i2c_master_transmit(rtc_handle, d, sizeof(d), -1);
+    if (err != ESP_OK) return err;
+
+    gpio_config_t io_conf = {
+        .intr_type = RTC_SQW_EDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = 1ULL << RTC_SQW_PIN,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    gpio_config(&io_conf);
+    return gpio_isr_handler_add(RTC_SQW_PIN, rtc_sqw_isr, NULL);
+}
+
+/* System time of the last SQW edge, and its esp_timer time */
+static int64_t rtc_sqw_edge(int64_t *timer_us) {
+    portENTER_CRITICAL(&s_sqw_lock);
+    *timer_us = s_sqw_timer_us;
+    portEXIT_CRITICAL(&s_sqw_lock);
+    return rtc_sys_us() - (esp_timer_get_time() - *timer_us);
+}
+
+/* The second an SQW edge started, from the RTC's own registers: read
+ * right after the edge they hold it. 0 when the RTC time is not valid or
+ * the edge is too old to tell. */
+static time_t rtc_edge_second(i2c_master_dev_handle_t rtc_handle, int64_t timer_us) {
+    struct tm tm;
+    bool valid;
+    if (rtc_read(rtc_handle, &tm, &valid) != ESP_OK || !valid) return 0;
+    if (esp_timer_get_time() - timer_us > 500000) return 0;
+    return mktime(&tm);
+}
+
+bool rtc_sqw_anchor(int64_t *timer_us, time_t *second) {
+    portENTER_CRITICAL(&s_sqw_lock);
+    *timer_us = s_anchor_timer_us;
+    *second = s_anchor_second;
+    portEXIT_CRITICAL(&s_sqw_lock);
+    return *second != 0 && esp_timer_get_time() - *timer_us < 2000000;
+}
+
+static void rtc_task(void *arg) {
+    i2c_master_dev_handle_t rtc_handle = (i2c_master_dev_handle_t)arg;
+    sync_logic(rtc_handle);
+    clock_init();
+    boot_mark(BOOT_RTC_SYNCED);
+    bool sqw = rtc_sqw_init(rtc_handle) == ESP_OK;
+    if (!sqw) {
+        ESP_LOGW(TAG, "No SQW interrupt, seconds follow the system clock");
+    }
+
+    rtc_discipline_t d = { 0 };
+    const int step_s = RTC_DISCIPLINE_PERIOD_S / RTC_DISCIPLINE_STEPS;
+
+    time_t last = 0;
+    time_t sqw_second = 0;      // RTC second of the last edge, 0 until read
+    int64_t sqw_timer_us = 0;
+    for (uint32_t seconds = 0;;) {
+        // Wait for the edge, at most until just after the next second: one
+        // after the last edge while they are counted, else the system's
+        int64_t wait_ms = sqw_second
+            ? (sqw_timer_us + 1000000 + RTC_SQW_GRACE_MS * 1000 - esp_timer_get_time()) / 1000
+            : (((int64_t)last + 1) * 1000000 + RTC_SQW_GRACE_MS * 1000 - rtc_sys_us()) / 1000;
+        if (sqw && !last) wait_ms = 2000; // The first second comes from the RTC too
+        if (wait_ms < 1) wait_ms = 1;
+        if (wait_ms > 2000) wait_ms = 2000;
+        bool edge = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms) + 1) > 0;
+
+        // An edge is labelled with the RTC's second: read once, then
+        // counted on by the edges since. Without one, the system second,
+        // and the RTC is read again at the next edge.
+        int64_t timer_us;
+        int64_t now_us = edge ? rtc_sqw_edge(&timer_us) : rtc_sys_us();
+        time_t second = (now_us + 500000) / 1000000;
+        if (!edge) {
+            sqw_second = 0;
+        } else {
+            metric_inc(&s_sqw_metric);
+            if (sqw_second) {
+                sqw_second += (timer_us - sqw_timer_us + 500000) / 1000000;
+            } else {
+                sqw_second = rtc_edge_second(rtc_handle, timer_us);
+            }
+            sqw_timer_us = timer_us;
+            if (sqw_second) {
+                second = sqw_second;
+                portENTER_CRITICAL(&s_sqw_lock);
+                s_anchor_timer_us = timer_us;
+                s_anchor_second = second;
+                portEXIT_CRITICAL(&s_sqw_lock);
+            }
+        }
+        if (second == last) continue; // This second was already handled
+        last = second;
+        clock_second(second);
+        diag_loop_tick(DIAG_LOOP_RTC);
+
+        if (seconds++ % RTC_DISCIPLINE_PERIOD_S == 0) {
+            // A write restarts the RTC second: drop the edges of the old
+            // one and read it again at the next
+            if (rtc_discipline_sample(rtc_handle, &d, edge ? &now_us : NULL)) {
+                ulTaskNotifyTake(pdTRUE, 0);
+                sqw_second = 0;
+            }
+        } else if (seconds % step_s == 0 && d.have_last) {
+            // Slews of a ppm or less round to 0 us: carry the rest over
+            d.freq_rem -= (int64_t)step_s * 1000000 * d.freq_ppb;
+            int64_t slew_us = d.freq_rem / 1000000000;
+            d.freq_rem -= slew_us * 1000000000;
+            if (slew_us) rtc_slew(&d, slew_us);
+        }
+    }
+}
+
+void rtc_discipline_start(i2c_master_dev_handle_t rtc_handle) {
+    xTaskCreate(rtc_task, "rtc", 3072, (void*)rtc_handle, RTC_TASK_PRIORITY, &s_rtc_task);
+}
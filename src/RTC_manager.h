@@ -1,12 +1,24 @@
 #ifndef RTC_MANAGER_H
 #define RTC_MANAGER_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <time.h>           // Essential for struct tm
 #include "driver/i2c_master.h"
 
+// Sets the system clock from the RTC, unless the RTC lost its time
 void sync_logic(i2c_master_dev_handle_t rtc_handle);
 
-// Change 'void' to 'struct tm' here
-struct tm get_and_return_time(char *buffer, size_t max_len);
+// Writes the system time to the RTC at the start of a second
+esp_err_t rtc_write_time(i2c_master_dev_handle_t rtc_handle);
+
+// Background task driven by the RTC's 1 Hz SQW output: sets the system
+// clock from the RTC and starts the clock service, then ticks it each
+// second and keeps slewing the system clock to the RTC
+void rtc_discipline_start(i2c_master_dev_handle_t rtc_handle);
+
+// esp_timer time of the last SQW edge and the second it started, to put
+// other clocks on the RTC's time. False without an edge in the last 2 s.
+bool rtc_sqw_anchor(int64_t *timer_us, time_t *second);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef BMX160_SAMPLE_H
+#define BMX160_SAMPLE_H
+
+#include <stdint.h>
+
+/* One BMX160 burst read from 0x0C: gyro x/y/z (0x0C - 0x11), accel x/y/z
+ * (0x12 - 0x17), little endian, then the 24-bit SENSORTIME (0x18 - 0x1A).
+ * Plain C so the host benchmark (tools/bench) can build it. */
+
+#define BMX160_SAMPLE_REG       0x0C
+#define BMX160_SAMPLE_LEN       15
+#define BMX160_GYRO_LSB_PER_DPS 16.4f       // +-2000 dps range
+#define BMX160_ACCEL_LSB_PER_G  16384.0f    // +-2 g range
+
+typedef struct {
+    float x;
+    float y;
+    float z;
+} sensor_xyz_t;
+
+static inline int16_t bmx160_le16(const uint8_t *p) {
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+// Gyro in dps
+static inline void bmx160_gyro(const uint8_t *buf, sensor_xyz_t *gyro) {
+    gyro->x = bmx160_le16(&buf[0]) / BMX160_GYRO_LSB_PER_DPS;
+    gyro->y = bmx160_le16(&buf[2]) / BMX160_GYRO_LSB_PER_DPS;
+    gyro->z = bmx160_le16(&buf[4]) / BMX160_GYRO_LSB_PER_DPS;
+}
+
+// Accel in g
+static inline void bmx160_accel(const uint8_t *buf, sensor_xyz_t *accel) {
+    accel->x = bmx160_le16(&buf[6]) / BMX160_ACCEL_LSB_PER_G;
+    accel->y = bmx160_le16(&buf[8]) / BMX160_ACCEL_LSB_PER_G;
+    accel->z = bmx160_le16(&buf[10]) / BMX160_ACCEL_LSB_PER_G;
+}
+
+// SENSORTIME, 39.0625 us per count
+static inline uint32_t bmx160_sensortime(const uint8_t *buf) {
+    return buf[12] | (buf[13] << 8) | ((uint32_t)buf[14] << 16);
+}
+
+#endif /* BMX160_SAMPLE_H */
@@ -0,0 +1,50 @@
+#include "boot_manager.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include <stdbool.h>
+
+static const char *TAG = "BOOT";
+
+static const char *s_stage_names[BOOT_STAGE_MAX] = {
+    "app_main", "tasks", "rtc", "bmx", "oled", "first sample", "first frame",
+};
+
+static int64_t s_stage_us[BOOT_STAGE_MAX];
+static uint32_t s_marked;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+METRIC_GAUGE(s_rtc_ms, "boot.rtc_ms");
+METRIC_GAUGE(s_bmx_ms, "boot.bmx_ms");
+METRIC_GAUGE(s_oled_ms, "boot.oled_ms");
+METRIC_GAUGE(s_first_sample_ms, "boot.first_sample_ms");
+METRIC_GAUGE(s_first_frame_ms, "boot.first_frame_ms");
+
+static void boot_report(void) {
+    metric_set(&s_rtc_ms, s_stage_us[BOOT_RTC_SYNCED] / 1000);
+    metric_set(&s_bmx_ms, s_stage_us[BOOT_BMX_READY] / 1000);
+    metric_set(&s_oled_ms, s_stage_us[BOOT_OLED_READY] / 1000);
+    metric_set(&s_first_sample_ms, s_stage_us[BOOT_FIRST_SAMPLE] / 1000);
+    metric_set(&s_first_frame_ms, s_stage_us[BOOT_FIRST_FRAME] / 1000);
+
+    // Since app_main() in brackets, that is the part this code controls
+    int64_t main_us = s_stage_us[BOOT_APP_MAIN];
+    for (int i = 0; i < BOOT_STAGE_MAX; i++) {
+        ESP_LOGI(TAG, "%-12s %5lld ms (+%lld ms)", s_stage_names[i],
+                 (long long)(s_stage_us[i] / 1000), (long long)((s_stage_us[i] - main_us) / 1000));
+    }
+}
+
+void boot_mark(boot_stage_t stage) {
+    int64_t now = esp_timer_get_time();
+    bool complete = false;
+    portENTER_CRITICAL(&s_lock);
+    if (!(s_marked & (1u << stage))) {
+        s_stage_us[stage] = now;
+        s_marked |= 1u << stage;
+        complete = (s_marked == (1u << BOOT_STAGE_MAX) - 1);
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (complete) boot_report();
+}
@@ -0,0 +1,24 @@
+#ifndef BOOT_MANAGER_H
+#define BOOT_MANAGER_H
+
+/* Boot timeline. Each peripheral is brought up by the task that uses it,
+ * so they come up side by side; every task marks its stages here. Times
+ * are esp_timer microseconds, which start with the app image, after the
+ * ROM and second stage bootloader. Once every stage is in, the timeline
+ * is logged and kept in the boot.* metrics. */
+
+typedef enum {
+    BOOT_APP_MAIN = 0,      // app_main() entered
+    BOOT_TASKS_STARTED,     // app_main() started the device tasks
+    BOOT_RTC_SYNCED,        // System clock set from the RTC (or left as is)
+    BOOT_BMX_READY,         // Accel and gyro report normal mode
+    BOOT_OLED_READY,        // Panel init sequence sent
+    BOOT_FIRST_SAMPLE,      // First sample published
+    BOOT_FIRST_FRAME,       // First frame handed to the panel
+    BOOT_STAGE_MAX
+} boot_stage_t;
+
+// Records the stage, only the first call per stage counts
+void boot_mark(boot_stage_t stage);
+
+#endif /* BOOT_MANAGER_H */
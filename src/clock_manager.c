@@ -0,0 +1,69 @@
+#include "clock_manager.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "ui_manager.h"
+
+static const char *TAG = "CLOCK";
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static time_t s_epoch;     // System time the cached fields belong to
+static struct tm s_tm;     // Published copy, read by clock_now()
+
+static void clock_publish(time_t epoch, const struct tm *tm) {
+    portENTER_CRITICAL(&s_lock);
+    s_epoch = epoch;
+    s_tm = *tm;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void clock_convert(time_t epoch) {
+    struct tm tm;
+    localtime_r(&epoch, &tm);
+    clock_publish(epoch, &tm);
+}
+
+/* One second on: seconds and minutes carry by hand, the hour rollover goes
+ * through localtime_r() so DST, month lengths and leap years stay right */
+static void clock_advance(time_t epoch) {
+    struct tm tm = clock_now();
+    if (++tm.tm_sec >= 60) {
+        tm.tm_sec = 0;
+        if (++tm.tm_min >= 60) {
+            clock_convert(epoch);
+            return;
+        }
+    }
+    clock_publish(epoch, &tm);
+}
+
+void clock_init(void) {
+    clock_convert(time(NULL));
+    ESP_LOGI(TAG, "Clock service started");
+}
+
+/* A jump other than one second (settimeofday, a missed tick) converts
+ * from scratch */
+void clock_second(time_t now) {
+    portENTER_CRITICAL(&s_lock);
+    time_t last = s_epoch;
+    portEXIT_CRITICAL(&s_lock);
+    if (now == last) return;
+    if (now == last + 1) {
+        clock_advance(now);
+    } else {
+        clock_convert(now);
+    }
+    ui_notify(UI_EVT_TICK);
+}
+
+void clock_resync(void) {
+    clock_convert(time(NULL));
+    ui_notify(UI_EVT_TICK);
+}
+
+struct tm clock_now(void) {
+    portENTER_CRITICAL(&s_lock);
+    struct tm tm = s_tm;
+    portEXIT_CRITICAL(&s_lock);
+    return tm;
+}
@@ -0,0 +1,24 @@
+#ifndef CLOCK_MANAGER_H
+#define CLOCK_MANAGER_H
+
+#include <time.h>
+
+/* Local wall clock for the UI. The full time_t to struct tm conversion
+ * runs once and the cached fields are then advanced on each second tick;
+ * the C library is asked again only at the hour rollover (day, month,
+ * DST) and when the system clock is set. Every tick posts UI_EVT_TICK.
+ * The ticks come from the RTC task (RTC_manager.c), on the 1 Hz SQW edge. */
+
+// Call once the system clock is set, e.g. after sync_logic()
+void clock_init(void);
+
+// A new second started, 'now' is its system time
+void clock_second(time_t now);
+
+// Convert again from the system clock, after settimeofday() or adjtime()
+void clock_resync(void);
+
+// Cached local time, as localtime_r() would return it for this second
+struct tm clock_now(void);
+
+#endif /* CLOCK_MANAGER_H */
@@ -0,0 +1,114 @@
+#include "diag_manager.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "DIAG";
+
+static const char *s_loop_names[DIAG_LOOP_MAX] = { "bmx", "ui", "rtc", "main" };
+static volatile uint32_t s_loop_count[DIAG_LOOP_MAX];
+static uint32_t s_loop_last[DIAG_LOOP_MAX];
+static int64_t s_last_sample_us;
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+static TaskStatus_t s_status[DIAG_TASKS_MAX];
+static TaskHandle_t s_prev_handle[DIAG_TASKS_MAX];
+static configRUN_TIME_COUNTER_TYPE s_prev_run_time[DIAG_TASKS_MAX];
+static int s_prev_count;
+static configRUN_TIME_COUNTER_TYPE s_prev_total;
+#endif
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static diag_snapshot_t s_snapshot;
+
+void diag_loop_tick(diag_loop_t loop) {
+    s_loop_count[loop]++;
+}
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+/* Run time of every task since the last sample, as a share of the total.
+ * The counters are 32-bit microseconds, fine for periods below an hour. */
+static void diag_sample_tasks(diag_snapshot_t *snap) {
+    configRUN_TIME_COUNTER_TYPE total;
+    UBaseType_t count = uxTaskGetSystemState(s_status, DIAG_TASKS_MAX, &total);
+    configRUN_TIME_COUNTER_TYPE elapsed = total - s_prev_total;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *status = &s_status[i];
+        configRUN_TIME_COUNTER_TYPE run = status->ulRunTimeCounter;
+        for (int p = 0; p < s_prev_count; p++) {
+            if (s_prev_handle[p] == status->xHandle) {
+                run -= s_prev_run_time[p];
+                break;
+            }
+        }
+        diag_task_t *task = &snap->tasks[i];
+        strncpy(task->name, status->pcTaskName, sizeof(task->name) - 1);
+        task->cpu_permille = elapsed ? (uint16_t)((uint64_t)run * 1000 / elapsed) : 0;
+        task->stack_free = status->usStackHighWaterMark; // StackType_t is a byte here
+        if (strncmp(task->name, "IDLE", 4) == 0) snap->idle_permille += task->cpu_permille;
+    }
+    snap->task_count = count;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_prev_handle[i] = s_status[i].xHandle;
+        s_prev_run_time[i] = s_status[i].ulRunTimeCounter;
+    }
+    s_prev_count = count;
+    s_prev_total = total;
+}
+#endif
+
+void diag_sample(void) {
+    diag_snapshot_t snap = { 0 };
+    int64_t now = esp_timer_get_time();
+    snap.period_ms = (uint32_t)((now - s_last_sample_us) / 1000);
+    s_last_sample_us = now;
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    diag_sample_tasks(&snap);
+#endif
+    snap.heap_free = esp_get_free_heap_size();
+    snap.heap_min = esp_get_minimum_free_heap_size();
+    for (int i = 0; i < DIAG_LOOP_MAX; i++) {
+        uint32_t count = s_loop_count[i];
+        snap.loop_hz[i] = snap.period_ms ? (count - s_loop_last[i]) * 1000 / snap.period_ms : 0;
+        s_loop_last[i] = count;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_snapshot = snap;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void diag_snapshot(diag_snapshot_t *out) {
+    portENTER_CRITICAL(&s_lock);
+    *out = s_snapshot;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const diag_task_t *diag_find_task(const diag_snapshot_t *snap, const char *name) {
+    for (int i = 0; i < snap->task_count; i++) {
+        if (strcmp(snap->tasks[i].name, name) == 0) return &snap->tasks[i];
+    }
+    return NULL;
+}
+
+void diag_dump(void) {
+    static diag_snapshot_t snap; // Too large for the caller's stack
+    diag_snapshot(&snap);
+    ESP_LOGI(TAG, "period %lu ms, idle %u.%u%%, heap %lu free, %lu min",
+             (unsigned long)snap.period_ms, snap.idle_permille / 10, snap.idle_permille % 10,
+             (unsigned long)snap.heap_free, (unsigned long)snap.heap_min);
+    ESP_LOGI(TAG, "%-16s %6s %10s", "task", "cpu %", "stack free");
+    for (int i = 0; i < snap.task_count; i++) {
+        const diag_task_t *task = &snap.tasks[i];
+        ESP_LOGI(TAG, "%-16s %4u.%u %10lu", task->name, task->cpu_permille / 10,
+                 task->cpu_permille % 10, (unsigned long)task->stack_free);
+    }
+    for (int i = 0; i < DIAG_LOOP_MAX; i++) {
+        ESP_LOGI(TAG, "loop %-11s %6lu /s", s_loop_names[i], (unsigned long)snap.loop_hz[i]);
+    }
+}
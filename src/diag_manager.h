@@ -0,0 +1,54 @@
+#ifndef DIAG_MANAGER_H
+#define DIAG_MANAGER_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/* Where the core spends its time: per task CPU share from the FreeRTOS
+ * run time counters (esp_timer based), lowest free stack per task, free
+ * and minimum heap, and how often the main loops run. diag_sample() takes
+ * a snapshot once per second; the diagnostics screen and diag_dump()
+ * show the last one. */
+
+#define DIAG_TASKS_MAX  16
+
+typedef enum {
+    DIAG_LOOP_BMX = 0,
+    DIAG_LOOP_UI,
+    DIAG_LOOP_RTC,
+    DIAG_LOOP_MAIN,
+    DIAG_LOOP_MAX
+} diag_loop_t;
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint16_t cpu_permille;  // Share of the last period
+    uint32_t stack_free;    // Lowest free stack so far, bytes
+} diag_task_t;
+
+typedef struct {
+    uint32_t period_ms;
+    uint16_t idle_permille;
+    uint32_t heap_free;
+    uint32_t heap_min;      // Lowest free heap since boot
+    uint32_t loop_hz[DIAG_LOOP_MAX];
+    int task_count;
+    diag_task_t tasks[DIAG_TASKS_MAX];
+} diag_snapshot_t;
+
+// One more pass of a main loop. One task per counter, no lock.
+void diag_loop_tick(diag_loop_t loop);
+
+// Takes a new snapshot, call about once per second from one task
+void diag_sample(void);
+
+// Copy of the last snapshot
+void diag_snapshot(diag_snapshot_t *out);
+
+// Task by name in a snapshot, NULL when it is not there
+const diag_task_t *diag_find_task(const diag_snapshot_t *snap, const char *name);
+
+// Logs the last snapshot as a table
+void diag_dump(void);
+
+#endif /* DIAG_MANAGER_H */
@@ -1,65 +1,111 @@
 #include "encoder_manager.h"
 #include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "globals.h" // We'll move the counter here if needed
-#define STEPS_PER_STATE 10  // Change this to adjust sensitivity
 #define DT_GPIO 4
 #define CLK_GPIO 5
 #include "esp_log.h"
+#include "ui_manager.h"
 
-static volatile int encoder_counter = 0;
-static int last_a = 0;
-static volatile TickType_t last_isr_tick = 0; // in ticks (for debounce)
-static volatile int prev_a = 0;
-static volatile int prev_b = 0;
+/* Both pins interrupt on both edges and every edge is decoded from the
+ * (CLK, DT) state pair, so no quarter step is lost to a single-edge
+ * decoder. Contact bounce moves back and forth between two neighbouring
+ * states and cancels itself out; an edge within ENCODER_GLITCH_US of the
+ * previous one adds no quarter step, but its state is kept. A detent is reported when the encoder is back in its rest
+ * state after more than half a detent of travel, which also keeps the
+ * count aligned when a transition was missed. */
+#define ENCODER_GLITCH_US       100     // Edges closer than this are noise
+#define ENCODER_REST_STATE      0x3     // Both pins high (pull-ups) at a detent
+#define ENCODER_QUEUE_LEN       16      // Power of two
 
-static void IRAM_ATTR encoder_isr_handler(void* arg) {
-    /* Debounce: ignore changes within DEBOUNCE_MS of previous change */
-    TickType_t now = xTaskGetTickCountFromISR();
-    const TickType_t debounce_ticks = pdMS_TO_TICKS(20);
-    if ((now - last_isr_tick) < debounce_ticks) {
-        return; // ignore bouncing
-    }
-    last_isr_tick = now;
+/* Quarter steps for (old state << 2 | new state), 0 for no or invalid moves */
+static const int8_t s_quad_table[16] = {
+     0, -1, +1,  0,
+    +1,  0,  0, -1,
+    -1,  0,  0, +1,
+     0, +1, -1,  0,
+};
+
+static uint8_t s_state;
+static int s_quarters;
+static int64_t s_last_edge_us;
+static int64_t s_last_detent_us;
+
+/* Single producer (the ISR), single consumer (the UI task): each side
+ * only writes its own index, so the queue needs no lock. */
+static encoder_event_t s_queue[ENCODER_QUEUE_LEN];
+static volatile uint32_t s_head;
+static volatile uint32_t s_tail;
+static volatile uint32_t s_dropped;
 
-    int a = gpio_get_level(CLK_GPIO); 
-    int b = gpio_get_level(DT_GPIO); 
-    prev_a = a;
-    prev_b = b;
+static inline uint8_t encoder_read_state(void) {
+    return (uint8_t)((gpio_get_level(CLK_GPIO) << 1) | gpio_get_level(DT_GPIO));
+}
+
+static void IRAM_ATTR encoder_push(int64_t now, int8_t dir) {
+    // Detents per second from the previous one, 32-bit math only in the ISR
+    int64_t dt = now - s_last_detent_us;
+    uint32_t velocity = (dt > 0 && dt < 1000000) ? 1000000u / (uint32_t)dt : 0;
+    if (velocity > UINT16_MAX) velocity = UINT16_MAX;
+    s_last_detent_us = now;
 
-    if (a != last_a) { 
-        if (b != a) {
-            encoder_counter++; 
-        } else {
-             encoder_counter--; 
-         }
+    uint32_t head = s_head;
+    if (head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE) == ENCODER_QUEUE_LEN) {
+        s_dropped++;
+        return;
     }
-    last_a = a;
+    s_queue[head % ENCODER_QUEUE_LEN] = (encoder_event_t){ .time_us = now, .dir = dir, .velocity = velocity };
+    __atomic_store_n(&s_head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void IRAM_ATTR encoder_isr_handler(void* arg) {
+    int64_t now = esp_timer_get_time();
+    uint8_t state = encoder_read_state();
+    if (state == s_state) return; // Bounced back already
+    // A glitch does not count, but its state does: the next edge is
+    // decoded from it
+    if (now - s_last_edge_us >= ENCODER_GLITCH_US) s_quarters += s_quad_table[(s_state << 2) | state];
+    s_last_edge_us = now;
+    s_state = state;
+    if (state != ENCODER_REST_STATE) return;
+
+    int8_t dir = 0;
+    if (s_quarters >= 2) dir = 1;
+    if (s_quarters <= -2) dir = -1;
+    s_quarters = 0;
+    if (dir == 0) return;
+
+    encoder_push(now, dir);
+    BaseType_t woken = pdFALSE;
+    ui_notify_from_isr(UI_EVT_INPUT, &woken);
+    portYIELD_FROM_ISR(woken);
 }
 
 void encoder_init(void) {
-    // 1. Configure DT Pin
+    // 1. Configure both pins, interrupts on both edges
     gpio_config_t io_conf = {
         .intr_type = GPIO_INTR_ANYEDGE,
         .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = (1ULL << DT_GPIO),
+        .pin_bit_mask = (1ULL << DT_GPIO) | (1ULL << CLK_GPIO),
         .pull_up_en = GPIO_PULLUP_ENABLE,
     };
     gpio_config(&io_conf);
+    s_state = encoder_read_state();
 
-    // 2. Configure CLK Pin (Reuse io_conf)
-    io_conf.pin_bit_mask = (1ULL << CLK_GPIO);
-    gpio_config(&io_conf);
-
-    // 3. Install ISR Service and Link the Handler
-    
+    // 2. Link the handler, the ISR service is installed by app_main
     gpio_isr_handler_add(CLK_GPIO, encoder_isr_handler, NULL);
+    gpio_isr_handler_add(DT_GPIO, encoder_isr_handler, NULL);
+}
 
+bool encoder_get_event(encoder_event_t *event) {
+    uint32_t tail = s_tail;
+    if (tail == __atomic_load_n(&s_head, __ATOMIC_ACQUIRE)) return false;
+    *event = s_queue[tail % ENCODER_QUEUE_LEN];
+    __atomic_store_n(&s_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
 }
 
-ui_screen_t encoder_get_screen_state(void) {
-    // This logic ensures the counter stays within 0 to (MAX-1)
-    int state = (encoder_counter/STEPS_PER_STATE) % UI_STATE_MAX;
-    ESP_LOGI("SENSOR", "Encoder Count: %d", encoder_counter);
-    if (state < 0) state += UI_STATE_MAX; 
-    return (ui_screen_t)state;
-}
\ No newline at end of file
+uint32_t encoder_dropped(void) {
+    return s_dropped;
+}
@@ -1,15 +1,27 @@
 #ifndef ENCODER_MANAGER_H
 #define ENCODER_MANAGER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef enum {
     UI_STATE_ACCEL = 0,
     UI_STATE_GYRO,
     UI_TIME,
+    UI_STATE_DIAG,
     UI_STATE_MAX // Helper to wrap back to 0
 } ui_screen_t;
 
+typedef struct {
+    int64_t time_us;    // esp_timer time of the detent
+    int8_t dir;         // +1 clockwise, -1 counter-clockwise
+    uint16_t velocity;  // Detents per second since the previous one, 0 after a pause
+} encoder_event_t;
+
 void encoder_init(void);
-// We'll use this in ui_manager.c to see which screen to draw
-ui_screen_t encoder_get_screen_state(void);
+// Next detent from the ISR queue, false when there is none. One reader only.
+bool encoder_get_event(encoder_event_t *event);
+// Detents lost because the queue was full
+uint32_t encoder_dropped(void);
 
 #endif
\ No newline at end of file
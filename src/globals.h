@@ -5,30 +5,24 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "driver/i2c_master.h"
+#include "bmx160_sample.h"
 
 /* Pins */
 #define SDA_PIN         8
 #define SCL_PIN         9
+#define RTC_SQW_PIN     3   // DS3231 SQW/INT, 1 Hz open drain
 
 /* Addresses */
 #define BMX160_ADDR     0x69
 #define SSD1306_ADDR    0x3C
 #define RTC_ADDR        0x68
 
-typedef struct {
-    float x;
-    float y;
-    float z;
-} sensor_xyz_t;
-
 /* Externs for shared data used by UI and Main */
 extern sensor_xyz_t g_accel;
 extern sensor_xyz_t g_gyro;
+extern int64_t g_sample_time_us;   // Wall clock of g_accel / g_gyro, SQW anchored
+extern uint32_t g_sensortime;      // BMX160 SENSORTIME of that sample, 39.0625 us
 extern SemaphoreHandle_t g_data_mutex;
 extern SemaphoreHandle_t g_gyro_mutex;
 extern volatile bool g_ui_started;
-extern uint32_t g_data_take_fail;
-extern uint32_t g_gyro_take_fail;
-extern uint32_t g_data_take_success;
-extern uint32_t g_gyro_take_success;
 #endif
\ No newline at end of file
@@ -4,23 +4,36 @@
 #include "freertos/task.h"
 #include "driver/i2c_master.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <sys/time.h>
 #include "globals.h"
 #include "RTC_manager.h"
 #include "encoder_manager.h"
 #include "ui_manager.h"
 #include "driver/gpio.h"
 #include "ssd1306.h"
-// Extern variable definitions
-uint32_t g_data_take_fail = 0;
-uint32_t g_gyro_take_fail = 0;
-uint32_t g_data_take_success = 0;
-uint32_t g_gyro_take_success = 0;
+#include "diag_manager.h"
+#include "metrics.h"
+#include "boot_manager.h"
+
+/* Seconds between diagnostics dumps on the serial log, 0 for none. A 'd'
+ * typed on the console dumps them once, an 'm' the metrics. */
+#define APP_DIAG_DUMP_S 0
+
+METRIC_COUNTER(s_gyro_published, "bmx.gyro_published");
+METRIC_COUNTER(s_gyro_lock_fail, "bmx.gyro_lock_fail");
+METRIC_COUNTER(s_accel_published, "bmx.accel_published");
+METRIC_COUNTER(s_accel_lock_fail, "bmx.accel_lock_fail");
+METRIC_COUNTER(s_read_fail, "bmx.read_fail");
+METRIC_HISTOGRAM(s_read_us, "bmx.read_us");
 
 static const char *TAG = "APP_MAIN";
 
 /* Global Sensor Storage */
 sensor_xyz_t g_accel = {0};
 sensor_xyz_t g_gyro = {0};
+int64_t g_sample_time_us = 0;
+uint32_t g_sensortime = 0;
 SemaphoreHandle_t g_data_mutex = NULL;
 SemaphoreHandle_t g_gyro_mutex = NULL;
 volatile bool g_ui_started = false;
@@ -36,53 +49,137 @@ static esp_err_t bmx_write_reg(i2c_master_dev_handle_t dev, uint8_t reg, uint8_t
 }
 
 /* --- BMX160 Sensor Initialization --- */
-bool bmx160_init_new(i2c_master_dev_handle_t dev) {
-    uint8_t id = 0;
-    if (bmx_read_regs(dev, 0x00, &id, 1) != ESP_OK || id != 0xD8) {
-        ESP_LOGE(TAG, "BMX160 not found! (ID: 0x%02X)", id);
-        return false;
+#define BMX_REG_CHIP_ID         0x00
+#define BMX_REG_PMU_STATUS      0x03
+#define BMX_REG_CMD             0x7E
+#define BMX_CHIP_ID             0xD8
+#define BMX_CMD_SOFT_RESET      0xB6
+#define BMX_CMD_ACC_NORMAL      0x11
+#define BMX_CMD_GYR_NORMAL      0x15
+#define BMX_PMU_ACC_MASK        0x30    // PMU_STATUS acc_pmu_status
+#define BMX_PMU_ACC_NORMAL      0x10
+#define BMX_PMU_GYR_MASK        0x0C    // PMU_STATUS gyr_pmu_status
+#define BMX_PMU_GYR_NORMAL      0x04
+#define BMX_STEP_TIMEOUT_MS     300     // Per state, then start over
+#define BMX_RETRY_MS            5000    // Before the next attempt after a timeout
+
+typedef enum {
+    BMX_PROBE = 0,      // Chip ID, then soft reset
+    BMX_RESET_WAIT,     // Until it answers again with all units suspended
+    BMX_ACC_WAIT,       // Accel normal mode requested
+    BMX_GYR_WAIT,       // Gyro normal mode requested
+    BMX_READY,
+} bmx_state_t;
+
+static const char *s_bmx_state_names[] = { "probe", "reset", "accel start", "gyro start" };
+
+/* One bring-up step. Readiness comes from PMU_STATUS instead of sleeping
+ * through the worst case start-up times, and the next CMD is only written
+ * once the last one took effect, as the datasheet asks. */
+static bmx_state_t bmx160_step(i2c_master_dev_handle_t dev, bmx_state_t state) {
+    uint8_t val = 0;
+    switch (state) {
+    case BMX_PROBE:
+        if (bmx_read_regs(dev, BMX_REG_CHIP_ID, &val, 1) != ESP_OK || val != BMX_CHIP_ID) return state;
+        bmx_write_reg(dev, BMX_REG_CMD, BMX_CMD_SOFT_RESET);
+        return BMX_RESET_WAIT;
+    case BMX_RESET_WAIT:
+        // NACKs while the reset runs
+        if (bmx_read_regs(dev, BMX_REG_PMU_STATUS, &val, 1) != ESP_OK || val != 0x00) return state;
+        bmx_write_reg(dev, BMX_REG_CMD, BMX_CMD_ACC_NORMAL);
+        return BMX_ACC_WAIT;
+    case BMX_ACC_WAIT:
+        if (bmx_read_regs(dev, BMX_REG_PMU_STATUS, &val, 1) != ESP_OK) return state;
+        if ((val & BMX_PMU_ACC_MASK) != BMX_PMU_ACC_NORMAL) return state;
+        bmx_write_reg(dev, BMX_REG_CMD, BMX_CMD_GYR_NORMAL);
+        return BMX_GYR_WAIT;
+    case BMX_GYR_WAIT:
+        if (bmx_read_regs(dev, BMX_REG_PMU_STATUS, &val, 1) != ESP_OK) return state;
+        return ((val & BMX_PMU_GYR_MASK) == BMX_PMU_GYR_NORMAL) ? BMX_READY : state;
+    default:
+        return state;
+    }
+}
+
+/* Brings the sensor up, polling once per tick. Runs in the read task, so
+ * it overlaps with the panel and RTC bring-up in their own tasks. */
+static void bmx160_bring_up(i2c_master_dev_handle_t dev) {
+    bmx_state_t state = BMX_PROBE;
+    TickType_t entered = xTaskGetTickCount();
+    for (;;) {
+        bmx_state_t next = bmx160_step(dev, state);
+        if (next == BMX_READY) break;
+        TickType_t now = xTaskGetTickCount();
+        if (next != state) {
+            state = next;
+            entered = now;
+        } else if (now - entered > pdMS_TO_TICKS(BMX_STEP_TIMEOUT_MS)) {
+            ESP_LOGE(TAG, "BMX160 stuck in %s, retrying in %d s", s_bmx_state_names[state], BMX_RETRY_MS / 1000);
+            vTaskDelay(pdMS_TO_TICKS(BMX_RETRY_MS));
+            state = BMX_PROBE;
+            entered = xTaskGetTickCount();
+            continue;
+        }
+        vTaskDelay(1);
     }
-    bmx_write_reg(dev, 0x7E, 0xB6); // Soft Reset
-    vTaskDelay(pdMS_TO_TICKS(100));
-    bmx_write_reg(dev, 0x7E, 0x11); // Accel Normal Mode
-    bmx_write_reg(dev, 0x7E, 0x15); // Gyro Normal Mode
-    vTaskDelay(pdMS_TO_TICKS(100));
     ESP_LOGI(TAG, "BMX160 Initialized (Accel + Gyro)");
-    return true;
+    boot_mark(BOOT_BMX_READY);
+}
+
+/* Wall clock time of an esp_timer time, counted from the last RTC SQW
+ * edge so it has the RTC's accuracy, else from the system clock */
+static int64_t sample_wall_time_us(int64_t timer_us) {
+    int64_t anchor_us;
+    time_t second;
+    if (rtc_sqw_anchor(&anchor_us, &second)) {
+        return (int64_t)second * 1000000 + (timer_us - anchor_us);
+    }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (esp_timer_get_time() - timer_us);
 }
 
 /* --- Task: Read Sensor Data --- */
 void bmx_read_task(void *arg) {
     i2c_master_dev_handle_t bmx_dev = (i2c_master_dev_handle_t)arg;
-    uint8_t buf[12]; // 6 bytes Gyro, 6 bytes Accel
-    
+    uint8_t buf[BMX160_SAMPLE_LEN];
+
+    bmx160_bring_up(bmx_dev);
     for (;;) {
-        // Read 12 bytes starting from 0x0C (Gyro LSB)
-        if (bmx_read_regs(bmx_dev, 0x0C, buf, 12) == ESP_OK) {
+        diag_loop_tick(DIAG_LOOP_BMX);
+        // Read 15 bytes starting from 0x0C (Gyro LSB), through SENSORTIME (0x18 - 0x1A)
+        int64_t read_start = esp_timer_get_time();
+        if (bmx_read_regs(bmx_dev, BMX160_SAMPLE_REG, buf, sizeof(buf)) == ESP_OK) {
+            int64_t read_end = esp_timer_get_time();
+            int64_t read_us = (read_start + read_end) / 2;
+            metric_record(&s_read_us, read_end - read_start);
             
             // 1. Process Gyro (0x0C - 0x11)
             if (xSemaphoreTake(g_gyro_mutex, pdMS_TO_TICKS(5)) == pdTRUE) {
-                g_gyro.x = (int16_t)((buf[1] << 8) | buf[0]) / 16.4f;
-                g_gyro.y = (int16_t)((buf[3] << 8) | buf[2]) / 16.4f;
-                g_gyro.z = (int16_t)((buf[5] << 8) | buf[4]) / 16.4f;
-                g_gyro_take_success++;
+                bmx160_gyro(buf, &g_gyro);
                 xSemaphoreGive(g_gyro_mutex);
-            } else { g_gyro_take_fail++; }
+                metric_inc(&s_gyro_published);
+            } else { metric_inc(&s_gyro_lock_fail); }
 
             // 2. Process Accel (0x12 - 0x17)
             if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(5)) == pdTRUE) {
-                g_accel.x = (int16_t)((buf[7] << 8) | buf[6]) / 16384.0f;
-                g_accel.y = (int16_t)((buf[9] << 8) | buf[8]) / 16384.0f;
-                g_accel.z = (int16_t)((buf[11] << 10) | buf[10]) / 16384.0f;
-                g_data_take_success++;
+                bmx160_accel(buf, &g_accel);
+                g_sample_time_us = sample_wall_time_us(read_us);
+                g_sensortime = bmx160_sensortime(buf);
                 xSemaphoreGive(g_data_mutex);
-            } else { g_data_take_fail++; }
+                metric_inc(&s_accel_published);
+                boot_mark(BOOT_FIRST_SAMPLE);
+            } else { metric_inc(&s_accel_lock_fail); }
+            ui_notify(UI_EVT_SAMPLE);
+        } else {
+            metric_inc(&s_read_fail);
         }
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 }
 
 void app_main(void) {
+    boot_mark(BOOT_APP_MAIN);
     ESP_LOGI(TAG, "Initializing System...");
 
     // 1. Initialize Bus
@@ -117,17 +214,22 @@ void app_main(void) {
     g_data_mutex = xSemaphoreCreateMutex();
     g_gyro_mutex = xSemaphoreCreateMutex();
 
-    // 6. Init Hardware Logic
-    sync_logic(rtc_handle);
-    bmx160_init_new(bmx_handle);
-
-    // 7. Start Tasks (Passing handles as arguments)
+    // 6. Each device task brings up its own device, side by side: the RTC
+    // task sets the system clock, the read task resets the BMX160 and the
+    // UI task initializes the panel. The I2C driver serializes the bus.
+    rtc_discipline_start(rtc_handle);
     xTaskCreate(bmx_read_task, "bmx_read", 3072, (void*)bmx_handle, 5, NULL);
     xTaskCreate(ui_task, "ui", 4096, (void*)oled_handle, 4, NULL);
+    boot_mark(BOOT_TASKS_STARTED);
 
-    
-    while(1) {
-        
+    // 7. Diagnostics: one snapshot per second
+    for (uint32_t seconds = 1;; seconds++) {
         vTaskDelay(pdMS_TO_TICKS(1000));
+        diag_loop_tick(DIAG_LOOP_MAIN);
+        diag_sample();
+        int c = getchar();
+        if (c == EOF) clearerr(stdin);
+        if (c == 'd' || (APP_DIAG_DUMP_S && seconds % APP_DIAG_DUMP_S == 0)) diag_dump();
+        if (c == 'm') metrics_log();
     }
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "METRICS";
+
+#define METRICS_LOG_MAX 1024    // Dump bytes that metrics_log() prints
+
+static metric_t *s_metrics = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Constructors run one at a time before the scheduler starts; the lock is
+ * for metrics registered later */
+void metrics_register(metric_t *metric) {
+    portENTER_CRITICAL(&s_lock);
+    metric->next = s_metrics;
+    s_metrics = metric;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+typedef struct {
+    uint8_t *p;
+    uint8_t *end;
+    bool full;
+} metrics_writer_t;
+
+static void metrics_put(metrics_writer_t *w, const void *data, size_t len) {
+    if (w->full || (size_t)(w->end - w->p) < len) {
+        w->full = true;
+        return;
+    }
+    memcpy(w->p, data, len);
+    w->p += len;
+}
+
+static void metrics_put_u8(metrics_writer_t *w, uint8_t value) {
+    metrics_put(w, &value, 1);
+}
+
+static void metrics_put_varint(metrics_writer_t *w, uint64_t value) {
+    uint8_t bytes[10];
+    int n = 0;
+    do {
+        bytes[n] = value & 0x7F;
+        value >>= 7;
+        if (value) bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    metrics_put(w, bytes, n);
+}
+
+size_t metrics_dump(uint8_t *buf, size_t size) {
+    static metric_t *metrics[METRICS_MAX];
+    static metric_value_t values[METRICS_MAX]; // Too large for the caller's stack
+    metrics_writer_t w = { .p = buf, .end = buf + size };
+
+    int count = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (metric_t *m = s_metrics; m && count < METRICS_MAX; m = m->next) {
+        metrics[count] = m;
+        values[count++] = m->value;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    metrics_put(&w, "MTRC", 4);
+    metrics_put_u8(&w, METRICS_DUMP_VERSION);
+    metrics_put_varint(&w, count);
+    metrics_put_varint(&w, esp_timer_get_time() / 1000);
+    for (int i = 0; i < count; i++) {
+        const metric_value_t *v = &values[i];
+        size_t name_len = strlen(metrics[i]->name);
+        if (name_len > UINT8_MAX) name_len = UINT8_MAX;
+        metrics_put_u8(&w, metrics[i]->type);
+        metrics_put_u8(&w, name_len);
+        metrics_put(&w, metrics[i]->name, name_len);
+        switch (metrics[i]->type) {
+        case METRIC_TYPE_COUNTER:
+            metrics_put_varint(&w, v->count);
+            break;
+        case METRIC_TYPE_GAUGE:
+            metrics_put_varint(&w, ((uint32_t)v->level << 1) ^ (uint32_t)(v->level >> 31));
+            break;
+        case METRIC_TYPE_HISTOGRAM:
+            metrics_put_varint(&w, v->hist.sum);
+            metrics_put_u8(&w, METRICS_HIST_BUCKETS);
+            for (int b = 0; b < METRICS_HIST_BUCKETS; b++) metrics_put_varint(&w, v->hist.buckets[b]);
+            break;
+        }
+    }
+    return w.full ? 0 : (size_t)(w.p - buf);
+}
+
+void metrics_log(void) {
+    static uint8_t dump[METRICS_LOG_MAX];
+    static char hex[2 * METRICS_LOG_MAX + 1];
+    static const char digits[] = "0123456789abcdef";
+    size_t len = metrics_dump(dump, sizeof(dump));
+    if (len == 0) {
+        ESP_LOGW(TAG, "Dump larger than %d bytes", METRICS_LOG_MAX);
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        hex[2 * i] = digits[dump[i] >> 4];
+        hex[2 * i + 1] = digits[dump[i] & 0xF];
+    }
+    hex[2 * len] = '\0';
+    ESP_LOGI(TAG, "%s", hex);
+}
@@ -0,0 +1,100 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Counters, gauges and latency histograms that any module defines where
+ * it uses them:
+ *
+ *   METRIC_COUNTER(s_read_fail, "bmx.read_fail");
+ *   ...
+ *   metric_inc(&s_read_fail);
+ *
+ * Each definition registers itself before app_main() through a
+ * constructor, so there is no central list to edit. An update is one
+ * atomic read-modify-write and takes no lock; the C3 has no atomic
+ * instructions, so the compiler runtime briefly masks interrupts instead.
+ * Not for ISRs, the runtime helpers are not in IRAM.
+ *
+ * metrics_dump() copies all values in one go with interrupts masked,
+ * which on the single core is a consistent cut (a histogram can miss the
+ * sum of a record that is half done), and encodes them as:
+ *
+ *   "MTRC", version (1), metric count (varint), uptime ms (varint), then
+ *   per metric: type (1 byte), name length (1 byte), name,
+ *     counter:   value (varint)
+ *     gauge:     value (zigzag varint)
+ *     histogram: sum (varint), bucket count (1 byte), buckets (varint)
+ *
+ * Varints are LEB128, 7 bits per byte, low bits first. Histogram bucket 0
+ * counts 0, bucket i values from 2^(i-1) to 2^i - 1, the last one all
+ * values above.
+ */
+
+#define METRICS_DUMP_VERSION    1
+#define METRICS_MAX             32  // Metrics a dump can hold
+#define METRICS_HIST_BUCKETS    20  // Last one from 2^18 on: 262 ms in us
+
+typedef enum {
+    METRIC_TYPE_COUNTER = 1,
+    METRIC_TYPE_GAUGE,
+    METRIC_TYPE_HISTOGRAM,
+} metric_type_t;
+
+typedef union {
+    uint32_t count;         // Counter
+    int32_t level;          // Gauge
+    struct {
+        uint64_t sum;
+        uint32_t buckets[METRICS_HIST_BUCKETS];
+    } hist;
+} metric_value_t;
+
+typedef struct metric {
+    const char *name;
+    metric_type_t type;
+    struct metric *next;    // Registry list
+    metric_value_t value;
+} metric_t;
+
+void metrics_register(metric_t *metric);
+
+#define METRIC_DEFINE_(var, metric_name, metric_type)                         \
+    static metric_t var = { .name = metric_name, .type = metric_type };       \
+    static void __attribute__((constructor)) var##_register(void) {           \
+        metrics_register(&var);                                               \
+    }
+
+#define METRIC_COUNTER(var, name)   METRIC_DEFINE_(var, name, METRIC_TYPE_COUNTER)
+#define METRIC_GAUGE(var, name)     METRIC_DEFINE_(var, name, METRIC_TYPE_GAUGE)
+#define METRIC_HISTOGRAM(var, name) METRIC_DEFINE_(var, name, METRIC_TYPE_HISTOGRAM)
+
+static inline void metric_inc(metric_t *m) {
+    __atomic_fetch_add(&m->value.count, 1, __ATOMIC_RELAXED);
+}
+
+static inline void metric_add(metric_t *m, uint32_t n) {
+    __atomic_fetch_add(&m->value.count, n, __ATOMIC_RELAXED);
+}
+
+static inline void metric_set(metric_t *m, int32_t level) {
+    __atomic_store_n(&m->value.level, level, __ATOMIC_RELAXED);
+}
+
+static inline void metric_record(metric_t *m, uint32_t value) {
+    int bucket = value ? 32 - __builtin_clz(value) : 0;
+    if (bucket >= METRICS_HIST_BUCKETS) bucket = METRICS_HIST_BUCKETS - 1;
+    __atomic_fetch_add(&m->value.hist.buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->value.hist.sum, value, __ATOMIC_RELAXED);
+}
+
+// Encodes all metrics into buf, returns the length or 0 when it does not fit.
+// One caller at a time.
+size_t metrics_dump(uint8_t *buf, size_t size);
+
+// Logs the dump as hex, one "MTRC" line, for a host tool to decode
+void metrics_log(void);
+
+#endif /* METRICS_H */
@@ -0,0 +1,131 @@
+#include "num_format.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define FMT_MAX 32 // Longest number: sign, 20 digits, point
+
+static const uint32_t s_pow10[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* Copy the text built in a scratch buffer, right aligned in width */
+static int fmt_out(char *buf, size_t size, const char *text, int len, int width) {
+    int pad = (width > len) ? width - len : 0;
+    if ((size_t)(pad + len) >= size) {
+        if (size > 0) buf[0] = '\0';
+        return -1;
+    }
+    memset(buf, ' ', pad);
+    memcpy(buf + pad, text, len);
+    buf[pad + len] = '\0';
+    return pad + len;
+}
+
+/* Digits of mag backwards from end, with a point in front of the last
+ * 'decimals' digits and at least one digit before it. 64-bit division is a
+ * library call on RV32, so it only runs for the digits above 2^32. */
+static char *fmt_digits(char *end, uint64_t mag, int decimals, bool negative) {
+    char *p = end;
+    int n = 0;
+    while (mag > UINT32_MAX) {
+        *--p = (char)('0' + mag % 10);
+        mag /= 10;
+        if (++n == decimals) *--p = '.';
+    }
+    uint32_t m = (uint32_t)mag;
+    do {
+        *--p = (char)('0' + m % 10);
+        m /= 10;
+        if (++n == decimals) *--p = '.';
+    } while (m != 0 || n <= decimals);
+    if (negative) *--p = '-';
+    return p;
+}
+
+int fmt_fixed(char *buf, size_t size, int32_t value, int decimals, int width) {
+    char text[FMT_MAX];
+    char *end = text + sizeof(text);
+    if (decimals < 0) decimals = 0;
+    if (decimals > 9) decimals = 9;
+    uint32_t mag = (value < 0) ? 0u - (uint32_t)value : (uint32_t)value;
+    char *p = fmt_digits(end, mag, decimals, value < 0);
+    return fmt_out(buf, size, p, end - p, width);
+}
+
+/* value = mant * 2^shift exactly, so value * 10^decimals can be rounded
+ * in integers: half to even, as printf does with the exact binary value. */
+int fmt_float(char *buf, size_t size, float value, int decimals, int width) {
+    union { float f; uint32_t u; } bits = { .f = value };
+    bool negative = (bits.u >> 31) != 0;
+    int exp = (bits.u >> 23) & 0xFF;
+    uint32_t mant = bits.u & 0x7FFFFF;
+    if (decimals < 0) decimals = 0;
+    if (decimals > 6) decimals = 6;
+
+    if (exp == 0xFF) {
+        const char *text = mant ? "nan" : (negative ? "-inf" : "inf");
+        return fmt_out(buf, size, text, strlen(text), width);
+    }
+    if (exp == 0) {
+        exp = 1; // Subnormal
+    } else {
+        mant |= 0x800000;
+    }
+    int shift = exp - 150;
+    uint64_t scaled = (uint64_t)mant * s_pow10[decimals]; // < 2^44
+
+    if (shift >= 0) {
+        if (shift > 9) return fmt_out(buf, size, "ovf", 3, width); // Keeps it below 2^53
+        scaled <<= shift;
+    } else if (shift < -45) {
+        scaled = 0; // Less than half of the last digit
+    } else {
+        int s = -shift;
+        uint64_t half = 1ull << (s - 1);
+        uint64_t rest = scaled & ((half << 1) - 1);
+        scaled >>= s;
+        if (rest > half || (rest == half && (scaled & 1))) scaled++;
+    }
+
+    char text[FMT_MAX];
+    char *end = text + sizeof(text);
+    char *p = fmt_digits(end, scaled, decimals, negative);
+    return fmt_out(buf, size, p, end - p, width);
+}
+
+int fmt_int(char *buf, size_t size, int32_t value, int width, char pad) {
+    char text[FMT_MAX];
+    char *end = text + sizeof(text);
+    uint32_t mag = (value < 0) ? 0u - (uint32_t)value : (uint32_t)value;
+    char *p = fmt_digits(end, mag, 0, false);
+    if (pad == '0') {
+        // Zeros go between the sign and the digits, like "%05d"
+        int digits = (value < 0) ? width - 1 : width;
+        if (digits > FMT_MAX - 2) digits = FMT_MAX - 2;
+        while (end - p < digits) *--p = '0';
+    }
+    if (value < 0) *--p = '-';
+    return fmt_out(buf, size, p, end - p, width);
+}
+
+static char *fmt_2d(char *p, int value) {
+    if (value < 0) value = 0;
+    if (value > 99) value = 99;
+    p[0] = (char)('0' + value / 10);
+    p[1] = (char)('0' + value % 10);
+    return p + 2;
+}
+
+int fmt_clock(char *buf, size_t size, int hours, int minutes, int seconds) {
+    if (size < 9) {
+        if (size > 0) buf[0] = '\0';
+        return -1;
+    }
+    char *p = fmt_2d(buf, hours);
+    *p++ = ':';
+    p = fmt_2d(p, minutes);
+    *p++ = ':';
+    p = fmt_2d(p, seconds);
+    *p = '\0';
+    return 8;
+}
@@ -0,0 +1,28 @@
+#ifndef NUM_FORMAT_H
+#define NUM_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Number to text without printf: no float printf, locale or heap, only
+ * the caller's buffer. Every function writes a NUL terminated string,
+ * right aligned in 'width' characters when the number is shorter, and
+ * returns its length. When it does not fit into 'size' bytes the buffer
+ * gets an empty string and the return value is -1.
+ */
+
+// value / 10^decimals, e.g. (-1234, 3) -> "-1.234". decimals 0 to 9.
+int fmt_fixed(char *buf, size_t size, int32_t value, int decimals, int width);
+
+// Same digits as printf("%.*f"), rounded from the exact float value.
+// decimals 0 to 6, "nan" / "inf" like printf, "ovf" from +-2^33 on.
+int fmt_float(char *buf, size_t size, float value, int decimals, int width);
+
+// Like printf("%*d"), or "%0*d" when pad is '0'
+int fmt_int(char *buf, size_t size, int32_t value, int width, char pad);
+
+// "HH:MM:SS", fields clamped to 00-99
+int fmt_clock(char *buf, size_t size, int hours, int minutes, int seconds);
+
+#endif /* NUM_FORMAT_H */
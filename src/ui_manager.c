@@ -1,15 +1,39 @@
 #include "ui_manager.h"
 #include "globals.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include "encoder_manager.h"
 #include "driver/i2c_master.h" // Essential for the handle
-#include "RTC_manager.h"
+#include "clock_manager.h"
 #include "ssd1306.h"
+#include "num_format.h"
+#include "diag_manager.h"
+#include "metrics.h"
+#include "boot_manager.h"
 static const char *TAG = "UI_MANAGER";
 
+/* 1: draw calls only touch the RAM frame and ssd1306_commit() sends it once.
+ * 0: immediate mode, every draw call goes straight to the bus (old behaviour).
+ * Frame times for both are logged at debug level to compare them. */
+#define UI_DEFERRED_DRAW 1
+
+/* 1: finished frames are handed to the ssd1306 flush task (double buffering),
+ * which diffs them against the panel contents and sends the changes while
+ * this task renders the next frame. Requires UI_DEFERRED_DRAW. */
+#define UI_FLUSH_TASK 1
+#define UI_FLUSH_TASK_PRIORITY 2
+
+/* Shortest time between two frames. Events that arrive sooner are
+ * collected and drawn together once it has passed. */
+#define UI_MIN_FRAME_MS 100
+
+static TaskHandle_t s_ui_task = NULL;
+
+METRIC_HISTOGRAM(s_frame_us, "ui.frame_us");
+
 /* * NOTE: Since your ssd1306 library likely uses the old driver, 
  * we must ensure that functions like ssd1306_display_text 
  * are only used if you have updated the library. 
@@ -17,14 +41,212 @@ static const char *TAG = "UI_MANAGER";
  * For now, we update the logic to use the handle.
  */
 
-void display_splash_screen(i2c_master_dev_handle_t dev_handle) {
-    // If your library requires the SSD1306_t struct, you'll need to 
-    // wrap the handle inside it or use direct new-driver commands.
-    ESP_LOGI(TAG, "Displaying Splash Screen...");
-    // Direct command to show activity (All pixels ON)
-    uint8_t cmd = 0xA5; 
-    i2c_master_transmit(dev_handle, &cmd, 1, -1);
-    vTaskDelay(pdMS_TO_TICKS(1000));
+/* Draw a value with the largest font (up to x3, and up to max_scale pages
+ * high) that still fits on one line */
+static void ui_draw_value(SSD1306_t *dev, int page, int max_scale, const char *text) {
+    int len = strlen(text);
+    int scale = (max_scale < 3) ? max_scale : 3;
+    while (scale > 1 && len * 8 * scale > ssd1306_get_width(dev)) scale--;
+    ssd1306_display_text_scaled(dev, page, 0, text, len, scale, false);
+}
+
+void ui_notify(uint32_t events) {
+    if (s_ui_task) xTaskNotify(s_ui_task, events, eSetBits);
+}
+
+void ui_notify_from_isr(uint32_t events, BaseType_t *woken) {
+    if (s_ui_task) xTaskNotifyFromISR(s_ui_task, events, eSetBits, woken);
+}
+
+/* Screens are drawn in two layers. The static layer (headings, labels) is
+ * rendered once, kept as page images and copied back whenever the screen
+ * is entered again. The dynamic layer is a list of regions, and only a
+ * region whose text changed is redrawn: its pages get the static layer
+ * back as background, then the new text. A new screen is one more entry
+ * in s_screens[]. */
+#define UI_REGIONS_MAX      6
+#define UI_STATIC_PAGES_MAX 2   // Cached pages per screen; a larger static layer is redrawn
+                                // on entry and must not share pages with regions
+#define UI_TEXT_MAX         32
+
+typedef struct {
+    int page;       // First page of the region
+    int pages;      // Height in pages
+    void (*format)(char *buf, size_t size); // Fetches and formats the value, or formats what fetch took
+} ui_region_t;
+
+typedef struct ui_screen_desc {
+    const char *title;
+    void (*draw_static)(SSD1306_t *dev, const struct ui_screen_desc *screen);
+    uint8_t static_pages;   // Bit per page the static layer draws on
+    uint32_t events;        // Events the regions depend on, besides input and alarms
+    void (*fetch)(void);    // Takes what the regions share, once per frame, or NULL
+    int region_count;
+    ui_region_t regions[UI_REGIONS_MAX];
+} ui_screen_desc_t;
+
+typedef struct {
+    bool valid;
+    uint8_t pages[UI_STATIC_PAGES_MAX][128];
+} ui_static_cache_t;
+
+static void ui_static_heading(SSD1306_t *dev, const ui_screen_desc_t *screen) {
+    ssd1306_display_text(dev, 0, screen->title, strlen(screen->title), false);
+}
+
+static void ui_fmt_accel(char *buf, size_t size) {
+    static sensor_xyz_t local_accel = {0}; // Last sample if the mutex is busy
+    if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        local_accel = g_accel;
+        xSemaphoreGive(g_data_mutex);
+    }
+    buf[0] = 'X';
+    fmt_float(buf + 1, size - 1, local_accel.x, 3, 0);
+}
+
+static void ui_fmt_gyro(char *buf, size_t size) {
+    static sensor_xyz_t local_gyro = {0};
+    if (xSemaphoreTake(g_gyro_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        local_gyro = g_gyro;
+        xSemaphoreGive(g_gyro_mutex);
+    }
+    buf[0] = 'X';
+    fmt_float(buf + 1, size - 1, local_gyro.x, 3, 0);
+}
+
+static void ui_fmt_time(char *buf, size_t size) {
+    struct tm now = clock_now();
+    fmt_clock(buf, size, now.tm_hour, now.tm_min, now.tm_sec);
+}
+
+/* Diagnostics lines, 16 characters at x1: "ui    4.2%  1234" is the CPU
+ * share over the last second and the lowest free stack in bytes */
+static diag_snapshot_t s_diag; // Too large for the UI task's stack
+
+// One snapshot per frame: it walks every task, and the lines of a frame
+// should show the same instant
+static void ui_fetch_diag(void) {
+    diag_snapshot(&s_diag);
+}
+
+static void ui_fmt_diag_task(char *buf, size_t size, const char *label, const char *name) {
+    const diag_task_t *task = diag_find_task(&s_diag, name);
+    int n = strlen(label);
+    memcpy(buf, label, n + 1);
+    if (!task) return;
+    n += fmt_fixed(buf + n, size - n, task->cpu_permille, 1, 5);
+    buf[n++] = '%';
+    fmt_int(buf + n, size - n, task->stack_free, 6, ' ');
+}
+
+static void ui_fmt_diag_ui(char *buf, size_t size) { ui_fmt_diag_task(buf, size, "ui  ", "ui"); }
+static void ui_fmt_diag_bmx(char *buf, size_t size) { ui_fmt_diag_task(buf, size, "bmx ", "bmx_read"); }
+static void ui_fmt_diag_rtc(char *buf, size_t size) { ui_fmt_diag_task(buf, size, "rtc ", "rtc"); }
+
+static void ui_fmt_diag_idle(char *buf, size_t size) {
+    int n = fmt_fixed(buf, size, s_diag.idle_permille, 1, 0);
+    memcpy(buf + n, "% idle", 7);
+}
+
+static void ui_fmt_diag_heap(char *buf, size_t size) {
+    memcpy(buf, "heap", 4);
+    int n = 4 + fmt_int(buf + 4, size - 4, s_diag.heap_free / 1024, 5, ' ');
+    buf[n++] = 'k';
+    n += fmt_int(buf + n, size - n, s_diag.heap_min / 1024, 5, ' ');
+    memcpy(buf + n, "k", 2);
+}
+
+// Main loop passes per second
+static void ui_fmt_diag_loops(char *buf, size_t size) {
+    static const char labels[DIAG_LOOP_MAX] = { 'b', 'u', 'r', 'm' };
+    memcpy(buf, "Hz", 2);
+    int n = 2;
+    for (int i = 0; i < DIAG_LOOP_MAX; i++) {
+        buf[n++] = ' ';
+        buf[n++] = labels[i];
+        n += fmt_int(buf + n, size - n, s_diag.loop_hz[i], 0, ' ');
+    }
+}
+
+/* Values are drawn by ui_draw_value(), up to x3: three pages */
+static const ui_screen_desc_t s_screens[UI_STATE_MAX] = {
+    [UI_STATE_ACCEL] = {
+        .title = "ACCEL", .draw_static = ui_static_heading, .static_pages = 1 << 0,
+        .events = UI_EVT_SAMPLE,
+        .region_count = 1, .regions = { { 2, 3, ui_fmt_accel } },
+    },
+    [UI_STATE_GYRO] = {
+        .title = "GYRO", .draw_static = ui_static_heading, .static_pages = 1 << 0,
+        .events = UI_EVT_SAMPLE,
+        .region_count = 1, .regions = { { 2, 3, ui_fmt_gyro } },
+    },
+    [UI_TIME] = {
+        .title = "REAL TIME", .draw_static = ui_static_heading, .static_pages = 1 << 0,
+        .events = UI_EVT_TICK,
+        .region_count = 1, .regions = { { 2, 3, ui_fmt_time } },
+    },
+    [UI_STATE_DIAG] = {
+        .title = "DIAG", .draw_static = ui_static_heading, .static_pages = 1 << 0,
+        .events = UI_EVT_TICK, .fetch = ui_fetch_diag,
+        .region_count = 6, .regions = {
+            { 1, 1, ui_fmt_diag_idle }, { 2, 1, ui_fmt_diag_ui }, { 3, 1, ui_fmt_diag_bmx },
+            { 4, 1, ui_fmt_diag_rtc }, { 5, 1, ui_fmt_diag_heap }, { 6, 1, ui_fmt_diag_loops },
+        },
+    },
+};
+
+static ui_static_cache_t s_static_cache[UI_STATE_MAX];
+
+/* Encoder steps per screen, change this to adjust sensitivity. A step is
+ * one CLK edge as the old edge counter had it, two per detent, so the
+ * feel is the same as before the detent decoding. */
+#define UI_STEPS_PER_SCREEN     10
+#define UI_STEPS_PER_DETENT     2
+
+/* Screen the encoder points at, after consuming its queued detents */
+static ui_screen_t ui_read_input(void) {
+    static int position = 0;
+    encoder_event_t event;
+    while (encoder_get_event(&event)) {
+        position += event.dir * UI_STEPS_PER_DETENT;
+    }
+    int state = (position / UI_STEPS_PER_SCREEN) % UI_STATE_MAX;
+    if (state < 0) state += UI_STATE_MAX;
+    return (ui_screen_t)state;
+}
+
+/* Put the static layer of a page back, returns false when it has no cached image */
+static bool ui_restore_static_page(SSD1306_t *dev, ui_screen_t id, int page) {
+    const ui_screen_desc_t *screen = &s_screens[id];
+    ui_static_cache_t *cache = &s_static_cache[id];
+    if (!cache->valid || !(screen->static_pages & (1 << page))) return false;
+    int slot = __builtin_popcount(screen->static_pages & ((1 << page) - 1));
+    ssd1306_display_image(dev, page, 0, cache->pages[slot], 128);
+    return true;
+}
+
+/* Blank panel with the static layer, from the cache when there is one */
+static void ui_enter_screen(SSD1306_t *dev, ui_screen_t id) {
+    const ui_screen_desc_t *screen = &s_screens[id];
+    ui_static_cache_t *cache = &s_static_cache[id];
+    ssd1306_clear_screen(dev, false);
+    if (cache->valid) {
+        for (int page = 0; page < dev->_pages; page++) ui_restore_static_page(dev, id, page);
+        return;
+    }
+    if (screen->draw_static) screen->draw_static(dev, screen);
+    if (__builtin_popcount(screen->static_pages) > UI_STATIC_PAGES_MAX) return;
+    int slot = 0;
+    for (int page = 0; page < dev->_pages; page++) {
+        if (screen->static_pages & (1 << page)) ssd1306_get_page(dev, page, cache->pages[slot++]);
+    }
+    cache->valid = true;
+}
+
+static void ui_clear_region(SSD1306_t *dev, ui_screen_t id, const ui_region_t *region) {
+    for (int page = region->page; page < region->page + region->pages; page++) {
+        if (!ui_restore_static_page(dev, id, page)) ssd1306_clear_line(dev, page, false);
+    }
 }
 
 void ui_task(void *pvParameters) {
@@ -38,9 +260,6 @@ void ui_task(void *pvParameters) {
     
     dev._i2c_dev_handle = oled_handle; // Use the handle created in app_main
     dev._address = CONFIG_SSD1306_ADDR;
-    dev._width = 128;
-    dev._height = 64;
-    dev._pages = 8;
     dev._flip = false;
 
     // 3. Manual Display Power-On via New Driver
@@ -52,59 +271,73 @@ void ui_task(void *pvParameters) {
         OLED_CMD_DISPLAY_ON          
     };
     i2c_master_transmit(oled_handle, init_cmds, sizeof(init_cmds), -1);
+    // Geometry, buffer and drive levels; skips the bus init with the new driver
+    ssd1306_init(&dev, 128, 64);
+    ssd1306_set_deferred(&dev, UI_DEFERRED_DRAW);
+    boot_mark(BOOT_OLED_READY);
+
+#if UI_DEFERRED_DRAW && UI_FLUSH_TASK
+    ssd1306_flush_task_start(&dev, UI_FLUSH_TASK_PRIORITY);
+#endif
+
+    s_ui_task = xTaskGetCurrentTaskHandle();
 
     ESP_LOGI(TAG, "UI Task Started with Handle: %p", oled_handle);
     g_ui_started = true;
 
-    sensor_xyz_t local_accel = {0};
-    sensor_xyz_t local_gyro = {0}; 
-    char buf[32];
-    
+    char buf[UI_TEXT_MAX];
+    char shown_text[UI_REGIONS_MAX][UI_TEXT_MAX];
+    ui_screen_t shown = UI_STATE_MAX; // Nothing on the panel yet
+    ui_screen_t state = UI_STATE_ACCEL;
+    TickType_t last_frame = 0;
+    uint32_t events = UI_EVT_INPUT; // Draw the first frame right away
+
     while (1) {
-        // Fetch current screen state from the encoder
-        ui_screen_t state = encoder_get_screen_state();
+        if (events & UI_EVT_INPUT) state = ui_read_input();
+        const ui_screen_desc_t *screen = &s_screens[state];
+        bool enter = (state != shown) || (events & UI_EVT_ALARM);
 
-        // Sync Sensor Data via Mutexes
-        if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-            local_accel = g_accel;
-            xSemaphoreGive(g_data_mutex);
-        }
-        if (xSemaphoreTake(g_gyro_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-            local_gyro = g_gyro;
-            xSemaphoreGive(g_gyro_mutex);
+        if (enter || (events & screen->events)) {
+            int64_t frame_start = esp_timer_get_time();
+            bool changed = enter;
+            if (enter) {
+                ui_enter_screen(&dev, state);
+                shown = state;
+            }
+            if (screen->fetch) screen->fetch();
+            // Same text in a region: the panel already shows it
+            for (int r = 0; r < screen->region_count; r++) {
+                const ui_region_t *region = &screen->regions[r];
+                region->format(buf, sizeof(buf));
+                if (!enter && strcmp(buf, shown_text[r]) == 0) continue;
+                if (!enter) ui_clear_region(&dev, state, region);
+                ui_draw_value(&dev, region->page, region->pages, buf);
+                strcpy(shown_text[r], buf);
+                changed = true;
+            }
+            if (changed) {
+#if UI_DEFERRED_DRAW && UI_FLUSH_TASK
+                ssd1306_swap_buffers(&dev);
+#else
+                ssd1306_commit(&dev);
+#endif
+                boot_mark(BOOT_FIRST_FRAME);
+                int64_t frame_us = esp_timer_get_time() - frame_start;
+                metric_record(&s_frame_us, frame_us);
+                ESP_LOGD(TAG, "Frame (%s): %lld us", UI_DEFERRED_DRAW ? "deferred" : "immediate", frame_us);
+                last_frame = xTaskGetTickCount();
+            }
         }
 
-        // Retrieve current time from the internal clock
-        char time_str[64];
-        struct tm now = get_and_return_time(time_str, sizeof(time_str));
-
-        // 4. Drawing Logic
-        // Clear screen before redrawing
-        ssd1306_clear_screen(&dev, false);
-
-        switch (state) {
-            case UI_STATE_ACCEL:
-                snprintf(buf, sizeof(buf), "X%.3f", local_accel.x);
-                ssd1306_display_text(&dev, 0, "ACCEL", 5, false);
-                ssd1306_display_text_x3(&dev, 2, buf, strlen(buf), false);
-                break;
-
-            case UI_STATE_GYRO:
-                snprintf(buf, sizeof(buf), "X%.3f", local_gyro.x);
-                ssd1306_display_text(&dev, 0, "GYRO", 4, false);
-                ssd1306_display_text_x3(&dev, 2, buf, strlen(buf), false);
-                break;
-
-            case UI_TIME: // Ensure this matches your enum in encoder_manager.h
-                snprintf(buf, sizeof(buf), "%02d:%02d:%02d", now.tm_hour, now.tm_min, now.tm_sec);
-                ssd1306_display_text(&dev, 0, "REAL TIME", 9, false);
-                ssd1306_display_text_x3(&dev, 2, buf, strlen(buf), false);
-                break;
-                
-            default:
-                break;
+        // Sleep until something happens, then keep to the frame interval
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+        diag_loop_tick(DIAG_LOOP_UI);
+        TickType_t since = xTaskGetTickCount() - last_frame;
+        if (since < pdMS_TO_TICKS(UI_MIN_FRAME_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(UI_MIN_FRAME_MS) - since);
+            uint32_t more = 0;
+            xTaskNotifyWait(0, UINT32_MAX, &more, 0);
+            events |= more;
         }
-
-        vTaskDelay(pdMS_TO_TICKS(200));
     }
-}
\ No newline at end of file
+}
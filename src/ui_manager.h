@@ -1,12 +1,22 @@
 #ifndef UI_MANAGER_H
 #define UI_MANAGER_H
 
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
 #include "driver/i2c_master.h" // FIX: Include the handle definition
 
+/* Events that wake the UI task. It sleeps until one of them is posted
+ * and redraws only when the event matters to the screen being shown. */
+#define UI_EVT_INPUT    (1u << 0) // Encoder moved
+#define UI_EVT_SAMPLE   (1u << 1) // New sensor sample published
+#define UI_EVT_TICK     (1u << 2) // Wall clock second changed
+#define UI_EVT_ALARM    (1u << 3) // Alarm fired
+
 // Only list the functions you want to call from main.c
 void ui_task(void *pvParameters);
 
-// Updated to accept the New Master Handle instead of the old library struct
-void display_splash_screen(i2c_master_dev_handle_t dev);
+// Post events to the UI task, ignored until it runs
+void ui_notify(uint32_t events);
+void ui_notify_from_isr(uint32_t events, BaseType_t *woken);
 
 #endif /* UI_MANAGER_H */
\ No newline at end of file
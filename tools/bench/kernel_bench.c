@@ -0,0 +1,525 @@
+/*
+ * Host micro-benchmarks of the drawing, sample conversion and formatting
+ * kernels: ns per call, measured in repetitions after a warm-up, with
+ * min / median / mean / standard deviation over the repetitions. Results
+ * go out as a table, CSV or JSON; a CSV of an earlier run can be given
+ * as the baseline to see the change per kernel.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -std=gnu11 -Itools/ssd1306_emu/host -Itools/ssd1306_emu -Ilib/ssd1306 -Isrc \
+ *      tools/bench/kernel_bench.c tools/bench/kernel_ref.c \
+ *      tools/ssd1306_emu/ssd1306_emu.c tools/ssd1306_emu/host_port.c \
+ *      lib/ssd1306/ssd1306.c lib/ssd1306/ssd1306_kernels.c lib/ssd1306/ssd1306_spi.c \
+ *      lib/ssd1306/ssd1306_fade.c src/num_format.c -lm -o kernel_bench
+ *   ./kernel_bench -f csv > base.csv          # before the change
+ *   ./kernel_bench -b base.csv -t 5           # after, exit code 1 when a
+ *                                             # median got 5 % slower
+ *
+ * Drawing runs in deferred mode, so the numbers are the frame buffer work
+ * alone; show_buffer is the driver packing the frame for the bus with no
+ * panel attached. Host numbers are for ranking and comparing commits;
+ * the C3 has no FPU, so the float kernels cost far more there.
+ *
+ * The ref_ kernels are the routines the library had before the word-wise
+ * and span rewrites (kernel_ref.c), on the same inputs, so the speedup of
+ * each rewrite can be read off the same table. Pixel kernels also report
+ * pixels per microsecond.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "bmx160_sample.h"
+#include "num_format.h"
+#include "kernel_ref.h"
+
+#define BENCH_WARMUP_NS     50000000    // Per kernel, also sizes the batch
+#define BENCH_REP_NS        10000000    // Target length of one repetition
+#define BENCH_REPS_DEFAULT  21
+#define BENCH_REPS_MAX      1000
+#define BENCH_MAX           64
+
+typedef struct {
+	const char * name;
+	void (*run)(int i); // One operation, i counts up from 0
+	int px; // Pixels one operation draws, 0 when that does not apply
+} bench_t;
+
+typedef struct {
+	const char * name;
+	long ops; // Per repetition
+	int reps;
+	int px;
+	double min_ns;
+	double median_ns;
+	double mean_ns;
+	double stddev_ns;
+} bench_result_t;
+
+static SSD1306_t s_dev;
+static volatile uint32_t s_sink; // Keeps the results alive
+
+static int64_t bench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Inputs */
+
+// 32x32 1 bpp, rows of 4 bytes MSB first, like the icons the UI would blit
+static uint8_t s_bitmap[32 * 4];
+static uint8_t s_samples[64][BMX160_SAMPLE_LEN];
+static float s_values[64];
+
+static void bench_inputs(void)
+{
+	uint32_t seed = 12345;
+	for (size_t i = 0; i < sizeof(s_bitmap); i++) {
+		seed = seed * 1664525u + 1013904223u;
+		s_bitmap[i] = seed >> 24;
+	}
+	for (int i = 0; i < 64; i++) {
+		for (int b = 0; b < BMX160_SAMPLE_LEN; b++) {
+			seed = seed * 1664525u + 1013904223u;
+			s_samples[i][b] = seed >> 24;
+		}
+		seed = seed * 1664525u + 1013904223u;
+		float range = (i & 1) ? 2000.0f : 16.0f;
+		s_values[i] = ((int32_t)(seed >> 8) - (1 << 23)) * (range / (1 << 23));
+	}
+}
+
+static void bench_init_dev(void)
+{
+	memset(&s_dev, 0, sizeof(s_dev));
+	s_dev._i2c_dev_handle = (i2c_master_dev_handle_t)1;
+	s_dev._address = I2C_ADDRESS;
+	ssd1306_init(&s_dev, 128, 64);
+	ssd1306_set_deferred(&s_dev, true);
+}
+
+/* Kernels */
+
+static void bench_text_x3(int i)
+{
+	static const char * texts[] = { "-1.234", "12:34", "0.987", "-2000" };
+	ssd1306_display_text_x3(&s_dev, 2, texts[i & 3], strlen(texts[i & 3]), false);
+}
+
+static void bench_text_x1(int i)
+{
+	ssd1306_display_text(&s_dev, i & 7, "ui    4.2%  1234", 16, i & 8);
+}
+
+static void bench_bitmap_aligned(int i)
+{
+	_ssd1306_bitmaps(&s_dev, (i & 3) * 32, 16, s_bitmap, 32, 32, false);
+}
+
+static void bench_bitmap_unaligned(int i)
+{
+	_ssd1306_bitmaps(&s_dev, (i & 63) + 5, (i & 15) + 3, s_bitmap, 32, 32, false);
+}
+
+static void bench_bitmap_xor(int i)
+{
+	_ssd1306_blit(&s_dev, (i & 63) + 5, (i & 15) + 3, s_bitmap, 32, 32, SSD1306_ROP_XOR, false);
+}
+
+static void bench_ref_bitmap_aligned(int i)
+{
+	ref_bitmaps(&s_dev, (i & 3) * 32, 16, s_bitmap, 32, 32, false);
+}
+
+static void bench_ref_bitmap_unaligned(int i)
+{
+	ref_bitmaps(&s_dev, (i & 63) + 5, (i & 15) + 3, s_bitmap, 32, 32, false);
+}
+
+static void bench_line(int i)
+{
+	// Steep, shallow and straight lines in turn
+	int x = i & 127, y = i & 63;
+	switch (i & 3) {
+	case 0: _ssd1306_line(&s_dev, 0, 0, x, 63, false); break;
+	case 1: _ssd1306_line(&s_dev, 127, y, 0, 63 - y, false); break;
+	case 2: _ssd1306_line(&s_dev, 0, y, 127, y, false); break;
+	default: _ssd1306_line(&s_dev, x, 0, x, 63, false); break;
+	}
+}
+
+static void bench_ref_line(int i)
+{
+	int x = i & 127, y = i & 63;
+	switch (i & 3) {
+	case 0: ref_line(&s_dev, 0, 0, x, 63, false); break;
+	case 1: ref_line(&s_dev, 127, y, 0, 63 - y, false); break;
+	case 2: ref_line(&s_dev, 0, y, 127, y, false); break;
+	default: ref_line(&s_dev, x, 0, x, 63, false); break;
+	}
+}
+
+static void bench_circle(int i)
+{
+	_ssd1306_circle(&s_dev, 64, 32, 4 + (i & 15) * 2, OLED_DRAW_ALL, false);
+}
+
+static void bench_ref_circle(int i)
+{
+	ref_circle(&s_dev, 64, 32, 4 + (i & 15) * 2, OLED_DRAW_ALL, false);
+}
+
+static void bench_disc(int i)
+{
+	_ssd1306_disc(&s_dev, 64, 32, 4 + (i & 7) * 3, OLED_DRAW_ALL, i & 8);
+}
+
+static void bench_ref_disc(int i)
+{
+	ref_disc(&s_dev, 64, 32, 4 + (i & 7) * 3, OLED_DRAW_ALL, i & 8);
+}
+
+// 40x20, every row offset within a page
+static void bench_fill_rect(int i)
+{
+	_ssd1306_fill_rect(&s_dev, (i & 63) + 3, i & 31, 40, 20, i & 32);
+}
+
+static void bench_ref_fill_rect(int i)
+{
+	ref_fill_rect(&s_dev, (i & 63) + 3, i & 31, 40, 20, i & 32);
+}
+
+static void bench_wrap_left(int i)
+{
+	ssd1306_wrap_arround(&s_dev, SCROLL_LEFT, 0, 7, -1);
+}
+
+static void bench_wrap_up(int i)
+{
+	ssd1306_wrap_arround(&s_dev, SCROLL_UP, 0, 63, -1);
+}
+
+static void bench_ref_wrap_up(int i)
+{
+	ref_scroll_up(&s_dev, 0, 63);
+}
+
+// A page minus a few bytes, starting at every word offset
+static void bench_invert(int i)
+{
+	ssd1306_invert(&s_dev._page[2]._segs[i & 3], 124);
+}
+
+static void bench_ref_invert(int i)
+{
+	ref_invert(&s_dev._page[2]._segs[i & 3], 124);
+}
+
+static void bench_flip(int i)
+{
+	ssd1306_flip(&s_dev._page[2]._segs[i & 3], 124);
+}
+
+static void bench_ref_flip(int i)
+{
+	ref_flip(&s_dev._page[2]._segs[i & 3], 124);
+}
+
+static void bench_rotate_image(int i)
+{
+	uint8_t image[8];
+	memcpy(image, &s_bitmap[(i & 15) * 8], 8);
+	ssd1306_rotate_image(image, i & 1);
+	s_sink += image[3];
+}
+
+static void bench_ref_rotate_image(int i)
+{
+	uint8_t image[8];
+	memcpy(image, &s_bitmap[(i & 15) * 8], 8);
+	ref_rotate_image(image, i & 1);
+	s_sink += image[3];
+}
+
+static void bench_show_buffer(int i)
+{
+	ssd1306_show_buffer(&s_dev);
+}
+
+static void bench_bmx_convert(int i)
+{
+	sensor_xyz_t gyro, accel;
+	const uint8_t * buf = s_samples[i & 63];
+	bmx160_gyro(buf, &gyro);
+	bmx160_accel(buf, &accel);
+	s_sink += (uint32_t)(gyro.x + accel.z) + bmx160_sensortime(buf);
+}
+
+static void bench_fmt_clock(int i)
+{
+	char buf[16];
+	fmt_clock(buf, sizeof(buf), i % 24, i % 60, (i >> 2) % 60);
+	s_sink += buf[7];
+}
+
+static void bench_snprintf_clock(int i)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%02d:%02d:%02d", i % 24, i % 60, (i >> 2) % 60);
+	s_sink += buf[7];
+}
+
+static void bench_fmt_float(int i)
+{
+	char buf[16];
+	fmt_float(buf, sizeof(buf), s_values[i & 63], 3, 0);
+	s_sink += buf[1];
+}
+
+static void bench_snprintf_float(int i)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%.3f", s_values[i & 63]);
+	s_sink += buf[1];
+}
+
+static const bench_t s_benches[] = {
+	{ "text_x3", bench_text_x3, 0 },
+	{ "text_x1", bench_text_x1, 0 },
+	{ "bitmap_aligned", bench_bitmap_aligned, 32 * 32 },
+	{ "bitmap_unaligned", bench_bitmap_unaligned, 32 * 32 },
+	{ "bitmap_xor", bench_bitmap_xor, 32 * 32 },
+	{ "ref_bitmap_aligned", bench_ref_bitmap_aligned, 32 * 32 },
+	{ "ref_bitmap_unaligned", bench_ref_bitmap_unaligned, 32 * 32 },
+	{ "line", bench_line, 0 },
+	{ "ref_line", bench_ref_line, 0 },
+	{ "circle", bench_circle, 0 },
+	{ "ref_circle", bench_ref_circle, 0 },
+	{ "disc", bench_disc, 0 },
+	{ "ref_disc", bench_ref_disc, 0 },
+	{ "fill_rect", bench_fill_rect, 40 * 20 },
+	{ "ref_fill_rect", bench_ref_fill_rect, 40 * 20 },
+	{ "wrap_left", bench_wrap_left, 0 },
+	{ "wrap_up", bench_wrap_up, 64 * 64 },
+	{ "ref_wrap_up", bench_ref_wrap_up, 64 * 64 },
+	{ "invert", bench_invert, 124 * 8 },
+	{ "ref_invert", bench_ref_invert, 124 * 8 },
+	{ "flip", bench_flip, 124 * 8 },
+	{ "ref_flip", bench_ref_flip, 124 * 8 },
+	{ "rotate_image", bench_rotate_image, 64 },
+	{ "ref_rotate_image", bench_ref_rotate_image, 64 },
+	{ "show_buffer", bench_show_buffer, 0 },
+	{ "bmx_convert", bench_bmx_convert, 0 },
+	{ "fmt_clock", bench_fmt_clock, 0 },
+	{ "snprintf_clock", bench_snprintf_clock, 0 },
+	{ "fmt_float", bench_fmt_float, 0 },
+	{ "snprintf_float", bench_snprintf_float, 0 },
+};
+
+/* Measurement */
+
+static int bench_cmp_double(const void * a, const void * b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static int64_t bench_batch(const bench_t * bench, long ops, int * i)
+{
+	int64_t start = bench_now_ns();
+	for (long n = 0; n < ops; n++) bench->run((*i)++);
+	return bench_now_ns() - start;
+}
+
+// Warm-up that also finds how many calls make one repetition
+static long bench_warm_up(const bench_t * bench, int * i)
+{
+	long ops = 1;
+	int64_t spent = 0;
+	int64_t took = 0;
+	while (spent < BENCH_WARMUP_NS) {
+		took = bench_batch(bench, ops, i);
+		spent += took;
+		if (took < BENCH_REP_NS / 4) ops *= 2;
+	}
+	long rep_ops = (long)((double)ops * BENCH_REP_NS / (took ? took : 1));
+	return rep_ops > 0 ? rep_ops : 1;
+}
+
+static bench_result_t bench_run(const bench_t * bench, int reps)
+{
+	static double ns[BENCH_REPS_MAX];
+	bench_result_t result = { .name = bench->name, .reps = reps, .px = bench->px };
+	int i = 0;
+
+	bench_init_dev();
+	result.ops = bench_warm_up(bench, &i);
+	double sum = 0;
+	for (int r = 0; r < reps; r++) {
+		ns[r] = (double)bench_batch(bench, result.ops, &i) / result.ops;
+		sum += ns[r];
+	}
+	result.mean_ns = sum / reps;
+	double var = 0;
+	for (int r = 0; r < reps; r++) var += (ns[r] - result.mean_ns) * (ns[r] - result.mean_ns);
+	result.stddev_ns = reps > 1 ? sqrt(var / (reps - 1)) : 0;
+	qsort(ns, reps, sizeof(ns[0]), bench_cmp_double);
+	result.min_ns = ns[0];
+	result.median_ns = (reps & 1) ? ns[reps / 2] : (ns[reps / 2 - 1] + ns[reps / 2]) / 2;
+	return result;
+}
+
+/* Baseline: the name and median_ns columns of an earlier CSV */
+
+typedef struct {
+	char name[32];
+	double median_ns;
+} bench_base_t;
+
+static int bench_read_base(const char * path, bench_base_t * base, int max)
+{
+	FILE * f = fopen(path, "r");
+	if (f == NULL) return -1;
+	char line[256];
+	int n = 0;
+	while (n < max && fgets(line, sizeof(line), f)) {
+		char name[32];
+		double min_ns, median_ns;
+		long ops;
+		int reps;
+		if (sscanf(line, "%31[^,],%ld,%d,%lf,%lf", name, &ops, &reps, &min_ns, &median_ns) != 5) continue;
+		strcpy(base[n].name, name);
+		base[n++].median_ns = median_ns;
+	}
+	fclose(f);
+	return n;
+}
+
+static const bench_base_t * bench_find_base(const bench_base_t * base, int count, const char * name)
+{
+	for (int i = 0; i < count; i++) {
+		if (strcmp(base[i].name, name) == 0) return &base[i];
+	}
+	return NULL;
+}
+
+/* Output */
+
+typedef enum { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON } bench_format_t;
+
+static void bench_print(bench_format_t format, const bench_result_t * results, int count,
+	const bench_base_t * base, int base_count, const char * label)
+{
+	if (format == FORMAT_CSV) {
+		printf("name,ops,reps,min_ns,median_ns,mean_ns,stddev_ns,px_per_us,change_pct\n");
+	} else if (format == FORMAT_JSON) {
+		printf("{\n  \"label\": \"%s\",\n  \"unit\": \"ns/op\",\n  \"results\": [\n", label);
+	} else {
+		printf("%-22s %10s %10s %10s %8s %8s %8s\n", "kernel", "min", "median", "mean", "sd %", "px/us", "change");
+	}
+	for (int k = 0; k < count; k++) {
+		const bench_result_t * r = &results[k];
+		const bench_base_t * b = bench_find_base(base, base_count, r->name);
+		double change = b ? (r->median_ns / b->median_ns - 1) * 100 : NAN;
+		double px_per_us = r->px ? r->px / r->median_ns * 1000 : 0;
+		if (format == FORMAT_CSV) {
+			printf("%s,%ld,%d,%.2f,%.2f,%.2f,%.2f,", r->name, r->ops, r->reps,
+				r->min_ns, r->median_ns, r->mean_ns, r->stddev_ns);
+			if (r->px) printf("%.1f", px_per_us);
+			printf(",");
+			if (b) printf("%.1f", change);
+			printf("\n");
+		} else if (format == FORMAT_JSON) {
+			printf("    { \"name\": \"%s\", \"ops\": %ld, \"reps\": %d, \"min_ns\": %.2f, "
+				"\"median_ns\": %.2f, \"mean_ns\": %.2f, \"stddev_ns\": %.2f",
+				r->name, r->ops, r->reps, r->min_ns, r->median_ns, r->mean_ns, r->stddev_ns);
+			if (r->px) printf(", \"px_per_us\": %.1f", px_per_us);
+			if (b) printf(", \"change_pct\": %.1f", change);
+			printf(" }%s\n", k + 1 < count ? "," : "");
+		} else {
+			printf("%-22s %10.1f %10.1f %10.1f %8.1f", r->name, r->min_ns, r->median_ns,
+				r->mean_ns, r->mean_ns ? r->stddev_ns / r->mean_ns * 100 : 0);
+			if (r->px) printf(" %8.1f", px_per_us);
+			else printf(" %8s", "");
+			if (b) printf(" %+7.1f%%", change);
+			printf("\n");
+		}
+	}
+	if (format == FORMAT_JSON) printf("  ]\n}\n");
+}
+
+int main(int argc, char ** argv)
+{
+	bench_format_t format = FORMAT_TABLE;
+	const char * base_path = NULL;
+	const char * filter = NULL;
+	const char * label = "";
+	double threshold = 0;
+	int reps = BENCH_REPS_DEFAULT;
+	int opt;
+	while ((opt = getopt(argc, argv, "f:b:t:r:k:l:")) != -1) {
+		if (opt == 'f' && strcmp(optarg, "csv") == 0) format = FORMAT_CSV;
+		else if (opt == 'f' && strcmp(optarg, "json") == 0) format = FORMAT_JSON;
+		else if (opt == 'f' && strcmp(optarg, "table") == 0) format = FORMAT_TABLE;
+		else if (opt == 'b') base_path = optarg;
+		else if (opt == 't') threshold = atof(optarg);
+		else if (opt == 'r') reps = atoi(optarg);
+		else if (opt == 'k') filter = optarg;
+		else if (opt == 'l') label = optarg;
+		else {
+			fprintf(stderr, "usage: %s [-f table|csv|json] [-r reps] [-k kernel] [-l label]"
+				" [-b base.csv [-t max_slowdown_pct]]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (reps < 1 || reps > BENCH_REPS_MAX) {
+		fprintf(stderr, "reps must be 1 to %d\n", BENCH_REPS_MAX);
+		return 2;
+	}
+
+	static bench_base_t base[BENCH_MAX];
+	int base_count = 0;
+	if (base_path) {
+		base_count = bench_read_base(base_path, base, BENCH_MAX);
+		if (base_count < 0) {
+			fprintf(stderr, "Could not read %s\n", base_path);
+			return 2;
+		}
+	}
+
+	// No panel: bus writes return at once, only the driver's own work counts
+	host_panel = NULL;
+	bench_inputs();
+
+	static bench_result_t results[BENCH_MAX];
+	int count = 0;
+	for (size_t k = 0; k < sizeof(s_benches) / sizeof(s_benches[0]); k++) {
+		if (filter && strcmp(filter, s_benches[k].name) != 0) continue;
+		results[count++] = bench_run(&s_benches[k], reps);
+	}
+	if (count == 0) {
+		fprintf(stderr, "No kernel named %s\n", filter);
+		return 2;
+	}
+	bench_print(format, results, count, base, base_count, label);
+
+	int slower = 0;
+	for (int k = 0; threshold > 0 && k < count; k++) {
+		const bench_base_t * b = bench_find_base(base, base_count, results[k].name);
+		if (b && results[k].median_ns > b->median_ns * (1 + threshold / 100)) {
+			fprintf(stderr, "%s: median %.1f ns, baseline %.1f ns\n", results[k].name,
+				results[k].median_ns, b->median_ns);
+			slower = 1;
+		}
+	}
+	return slower;
+}
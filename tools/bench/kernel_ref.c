@@ -0,0 +1,251 @@
+#include <string.h>
+
+#include "kernel_ref.h"
+
+// Bit by bit, eight rounds per byte
+uint8_t ref_rotate_byte(uint8_t ch1)
+{
+	uint8_t ch2 = 0;
+	for (int j = 0; j < 8; j++) {
+		ch2 = (ch2 << 1) + (ch1 & 0x01);
+		ch1 = ch1 >> 1;
+	}
+	return ch2;
+}
+
+void ref_invert(uint8_t * buf, size_t blen)
+{
+	for (size_t i = 0; i < blen; i++) buf[i] = ~buf[i];
+}
+
+void ref_flip(uint8_t * buf, size_t blen)
+{
+	for (size_t i = 0; i < blen; i++) buf[i] = ref_rotate_byte(buf[i]);
+}
+
+// Bit by bit: image[i] bit (7-j) = old image[j] bit i
+void ref_rotate_image(uint8_t * image, bool flip)
+{
+	uint8_t _image[8];
+	uint8_t _smask = 0x01;
+	for (int i = 0; i < 8; i++) {
+		uint8_t _dmask = 0x80;
+		_image[i] = 0;
+		for (int j = 0; j < 8; j++) {
+			if (image[j] & _smask) _image[i] = _image[i] + _dmask;
+			_dmask = _dmask >> 1;
+		}
+		_smask = _smask << 1;
+	}
+	for (int i = 0; i < 8; i++) image[i] = _image[i];
+	if (flip) ref_flip(image, 8);
+}
+
+// The SCROLL_UP branch of ssd1306_wrap_arround: one row, byte by byte
+void ref_scroll_up(SSD1306_t * dev, int start, int end)
+{
+	if (end >= dev->_width) end = dev->_width - 1;
+	uint8_t wk0, wk1, wk2;
+	uint8_t save[128];
+	for (int seg = 0; seg < 128; seg++) save[seg] = dev->_page[0]._segs[seg];
+	for (int page = 0; page < dev->_pages - 1; page++) {
+		for (int seg = start; seg <= end; seg++) {
+			wk0 = dev->_page[page]._segs[seg];
+			wk1 = dev->_page[page + 1]._segs[seg];
+			if (dev->_flip) { wk0 = ref_rotate_byte(wk0); wk1 = ref_rotate_byte(wk1); }
+			wk2 = (wk0 >> 1) | ((wk1 & 0x01) << 7);
+			if (dev->_flip) wk2 = ref_rotate_byte(wk2);
+			dev->_page[page]._segs[seg] = wk2;
+		}
+	}
+	int pages = dev->_pages - 1;
+	for (int seg = start; seg <= end; seg++) {
+		wk0 = dev->_page[pages]._segs[seg];
+		wk1 = save[seg];
+		if (dev->_flip) { wk0 = ref_rotate_byte(wk0); wk1 = ref_rotate_byte(wk1); }
+		wk2 = (wk0 >> 1) | ((wk1 & 0x01) << 7);
+		if (dev->_flip) wk2 = ref_rotate_byte(wk2);
+		dev->_page[pages]._segs[seg] = wk2;
+	}
+}
+
+// The SCROLL_DOWN branch of ssd1306_wrap_arround
+void ref_scroll_down(SSD1306_t * dev, int start, int end)
+{
+	if (end >= dev->_width) end = dev->_width - 1;
+	uint8_t wk0, wk1, wk2;
+	uint8_t save[128];
+	int pages = dev->_pages - 1;
+	for (int seg = 0; seg < 128; seg++) save[seg] = dev->_page[pages]._segs[seg];
+	for (int page = pages; page > 0; page--) {
+		for (int seg = start; seg <= end; seg++) {
+			wk0 = dev->_page[page]._segs[seg];
+			wk1 = dev->_page[page - 1]._segs[seg];
+			if (dev->_flip) { wk0 = ref_rotate_byte(wk0); wk1 = ref_rotate_byte(wk1); }
+			wk2 = (wk0 << 1) | ((wk1 & 0x80) >> 7);
+			if (dev->_flip) wk2 = ref_rotate_byte(wk2);
+			dev->_page[page]._segs[seg] = wk2;
+		}
+	}
+	for (int seg = start; seg <= end; seg++) {
+		wk0 = dev->_page[0]._segs[seg];
+		wk1 = save[seg];
+		if (dev->_flip) { wk0 = ref_rotate_byte(wk0); wk1 = ref_rotate_byte(wk1); }
+		wk2 = (wk0 << 1) | ((wk1 & 0x80) >> 7);
+		if (dev->_flip) wk2 = ref_rotate_byte(wk2);
+		dev->_page[0]._segs[seg] = wk2;
+	}
+}
+
+// Row y of a seg, as the scroll code sees it: flip mirrors the bits of
+// each page, not the page order
+static int ref_row_bit(SSD1306_t * dev, int y)
+{
+	return dev->_flip ? 7 - (y & 7) : (y & 7);
+}
+
+// Pixel by pixel: row y of the result is row y - lines of the original,
+// taken modulo the height with wrap and blank when out of range without
+void ref_vertical_shift(SSD1306_t * dev, int start, int end, int lines, bool wrap)
+{
+	int rows = dev->_pages * 8;
+	if (start < 0) start = 0;
+	if (end >= dev->_width) end = dev->_width - 1;
+	for (int seg = start; seg <= end; seg++) {
+		uint8_t col[8];
+		for (int page = 0; page < dev->_pages; page++) col[page] = dev->_page[page]._segs[seg];
+		for (int y = 0; y < rows; y++) {
+			int from = y - lines;
+			int on = 0;
+			if (wrap) from = ((from % rows) + rows) % rows;
+			if (from >= 0 && from < rows) on = (col[from / 8] >> ref_row_bit(dev, from)) & 1;
+			uint8_t mask = 1 << ref_row_bit(dev, y);
+			if (on) dev->_page[y / 8]._segs[seg] |= mask;
+			else dev->_page[y / 8]._segs[seg] &= ~mask;
+		}
+	}
+}
+
+// Bresenham, one pixel at a time
+void ref_line(SSD1306_t * dev, int x1, int y1, int x2, int y2, bool invert)
+{
+	int dx = (x2 > x1) ? x2 - x1 : x1 - x2;
+	int dy = (y2 > y1) ? y2 - y1 : y1 - y2;
+	int sx = (x2 > x1) ? 1 : -1;
+	int sy = (y2 > y1) ? 1 : -1;
+	int E;
+	if (dx > dy) {
+		E = -dx;
+		for (int i = 0; i <= dx; i++) {
+			_ssd1306_pixel(dev, x1, y1, invert);
+			x1 += sx;
+			E += 2 * dy;
+			if (E >= 0) {
+				y1 += sy;
+				E -= 2 * dx;
+			}
+		}
+	} else {
+		E = -dy;
+		for (int i = 0; i <= dy; i++) {
+			_ssd1306_pixel(dev, x1, y1, invert);
+			y1 += sy;
+			E += 2 * dx;
+			if (E >= 0) {
+				x1 += sx;
+				E -= 2 * dy;
+			}
+		}
+	}
+}
+
+void ref_circle(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert)
+{
+	int x = 0;
+	int y = -r;
+	int err = 2 - 2 * r;
+	int old_err;
+	do {
+		if ((opt & OLED_DRAW_UPPER_LEFT) == OLED_DRAW_UPPER_LEFT)
+			_ssd1306_pixel(dev, x0 - x, y0 + y, invert);
+		if ((opt & OLED_DRAW_UPPER_RIGHT) == OLED_DRAW_UPPER_RIGHT)
+			_ssd1306_pixel(dev, x0 - y, y0 - x, invert);
+		if ((opt & OLED_DRAW_LOWER_RIGHT) == OLED_DRAW_LOWER_RIGHT)
+			_ssd1306_pixel(dev, x0 + x, y0 - y, invert);
+		if ((opt & OLED_DRAW_LOWER_LEFT) == OLED_DRAW_LOWER_LEFT)
+			_ssd1306_pixel(dev, x0 + y, y0 + x, invert);
+		if ((old_err = err) <= x) err += ++x * 2 + 1;
+		if (old_err > y || err > x) err += ++y * 2 + 1;
+	} while (y < 0);
+}
+
+// A per-pixel vertical line for each quadrant of each column
+void ref_disc(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert)
+{
+	int x = 0;
+	int y = -r;
+	int err = 2 - 2 * r;
+	int old_err;
+	int ChangeX = 1;
+	do {
+		if (ChangeX) {
+			if ((opt & OLED_DRAW_LOWER_LEFT) == OLED_DRAW_LOWER_LEFT)
+				ref_line(dev, x0 - x, y0 - y, x0 - x, y0, invert);
+			if ((opt & OLED_DRAW_UPPER_LEFT) == OLED_DRAW_UPPER_LEFT)
+				ref_line(dev, x0 - x, y0, x0 - x, y0 + y, invert);
+			if ((opt & OLED_DRAW_LOWER_RIGHT) == OLED_DRAW_LOWER_RIGHT)
+				ref_line(dev, x0 + x, y0 - y, x0 + x, y0, invert);
+			if ((opt & OLED_DRAW_UPPER_RIGHT) == OLED_DRAW_UPPER_RIGHT)
+				ref_line(dev, x0 + x, y0, x0 + x, y0 + y, invert);
+		}
+		ChangeX = (old_err = err) <= x;
+		if (ChangeX) err += ++x * 2 + 1;
+		if (old_err > y || err > x) err += ++y * 2 + 1;
+	} while (y <= 0);
+}
+
+void ref_fill_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert)
+{
+	for (int y = ypos; y < ypos + height; y++)
+		for (int x = xpos; x < xpos + width; x++) _ssd1306_pixel(dev, x, y, invert);
+}
+
+// One ssd1306_copy_bit() per pixel, width a multiple of 8
+void ref_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert)
+{
+	if ((width % 8) != 0) return;
+	int _width = width / 8;
+	uint8_t wk0;
+	uint8_t wk1;
+	uint8_t wk2;
+	uint8_t page = (ypos / 8);
+	uint8_t _seg = xpos;
+	uint8_t dstBits = (ypos % 8);
+	int offset = 0;
+	for (int _height = 0; _height < height; _height++) {
+		for (int index = 0; index < _width; index++) {
+			for (int srcBits = 7; srcBits >= 0; srcBits--) {
+				wk0 = dev->_page[page]._segs[_seg];
+				if (dev->_flip) wk0 = ref_rotate_byte(wk0);
+
+				wk1 = bitmap[index + offset];
+				if (invert) wk1 = ~wk1;
+
+				wk2 = ssd1306_copy_bit(wk1, srcBits, wk0, dstBits);
+				if (dev->_flip) wk2 = ref_rotate_byte(wk2);
+
+				if (_seg >= 128) break;
+				if (page >= dev->_pages) break;
+				dev->_page[page]._segs[_seg] = wk2;
+				_seg++;
+			}
+		}
+		offset = offset + _width;
+		dstBits++;
+		_seg = xpos;
+		if (dstBits == 8) {
+			page++;
+			dstBits = 0;
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef KERNEL_REF_H_
+#define KERNEL_REF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ssd1306.h"
+
+// The frame buffer routines as they were before the word-wise and span
+// based rewrites (the baseline lib/ssd1306/ssd1306.c), kept on the host
+// to time and check the library against. Same arguments as the library
+// functions; like the originals they do no clipping on the left or top.
+// ref_vertical_shift is not a copy but a pixel by pixel model of
+// ssd1306_vertical_shift, for the shifts the old code could not do.
+// The shape routines are the old per-pixel loops on top of the library's
+// _ssd1306_pixel, so they clip like the library and the two differ only
+// in span against pixel work.
+
+uint8_t ref_rotate_byte(uint8_t ch1);
+void ref_invert(uint8_t * buf, size_t blen);
+void ref_flip(uint8_t * buf, size_t blen);
+void ref_rotate_image(uint8_t * image, bool flip);
+void ref_scroll_up(SSD1306_t * dev, int start, int end);
+void ref_scroll_down(SSD1306_t * dev, int start, int end);
+void ref_vertical_shift(SSD1306_t * dev, int start, int end, int lines, bool wrap);
+void ref_line(SSD1306_t * dev, int x1, int y1, int x2, int y2, bool invert);
+void ref_circle(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert);
+void ref_disc(SSD1306_t * dev, int x0, int y0, int r, unsigned int opt, bool invert);
+void ref_fill_rect(SSD1306_t * dev, int xpos, int ypos, int width, int height, bool invert);
+void ref_bitmaps(SSD1306_t * dev, int xpos, int ypos, const uint8_t * bitmap, int width, int height, bool invert);
+
+#endif /* KERNEL_REF_H_ */
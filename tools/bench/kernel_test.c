@@ -0,0 +1,289 @@
+/*
+ * Host unit tests of the frame buffer kernels (ssd1306_kernels.c) against
+ * the routines they replaced (kernel_ref.c). rotate_byte is checked over
+ * all 256 bytes and invert / flip at every alignment and length up to a
+ * few words. transpose8 and rotate_image only move bits around, so they
+ * are linear over GF(2): matching the bit loops on the zero block and on
+ * all 64 single-bit blocks proves them equal on every input; random
+ * blocks are run on top of that. vertical_shift is checked against the
+ * old one-row SCROLL_UP / SCROLL_DOWN code and against a pixel by pixel
+ * model for every shift, with and without wrap, flipped or not. The span
+ * based line, circle, disc and fill_rect must draw the same pixels as the
+ * per-pixel loops on random shapes, partly off the panel.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -std=gnu11 -Itools/ssd1306_emu/host -Itools/ssd1306_emu -Ilib/ssd1306 \
+ *      tools/bench/kernel_test.c tools/bench/kernel_ref.c \
+ *      tools/ssd1306_emu/ssd1306_emu.c tools/ssd1306_emu/host_port.c \
+ *      lib/ssd1306/ssd1306.c lib/ssd1306/ssd1306_kernels.c lib/ssd1306/ssd1306_spi.c \
+ *      lib/ssd1306/ssd1306_fade.c -o kernel_test
+ *   ./kernel_test                          # exit code 1 on a mismatch
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "kernel_ref.h"
+
+static SSD1306_t s_dev;
+static SSD1306_t s_ref;
+static uint32_t s_seed = 0x12345678;
+static long s_checks;
+static long s_failures;
+
+static uint32_t test_rand(void)
+{
+	s_seed ^= s_seed << 13;
+	s_seed ^= s_seed >> 17;
+	s_seed ^= s_seed << 5;
+	return s_seed;
+}
+
+static void test_fill(uint8_t * buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) buf[i] = test_rand();
+}
+
+// Counts the check, reports the first few failures
+static void test_expect(const char * name, int ok, const char * fmt, ...)
+{
+	s_checks++;
+	if (ok) return;
+	if (s_failures++ < 10) {
+		va_list args;
+		va_start(args, fmt);
+		fprintf(stderr, "%s: mismatch at ", name);
+		vfprintf(stderr, fmt, args);
+		fprintf(stderr, "\n");
+		va_end(args);
+	}
+}
+
+static void test_report(const char * name, long checks, long failures)
+{
+	printf("%s,%ld,%ld\n", name, s_checks - checks, s_failures - failures);
+}
+
+static void test_init_dev(SSD1306_t * dev, int height, bool flip)
+{
+	memset(dev, 0, sizeof(*dev));
+	dev->_i2c_dev_handle = (i2c_master_dev_handle_t)1;
+	dev->_address = I2C_ADDRESS;
+	ssd1306_init(dev, 128, height);
+	ssd1306_set_deferred(dev, true);
+	dev->_flip = flip;
+}
+
+static void test_random_frame(void)
+{
+	for (int page = 0; page < s_dev._pages; page++) {
+		test_fill(s_dev._page[page]._segs, 128);
+		memcpy(s_ref._page[page]._segs, s_dev._page[page]._segs, 128);
+	}
+}
+
+static int test_same_frame(void)
+{
+	for (int page = 0; page < s_dev._pages; page++)
+		if (memcmp(s_dev._page[page]._segs, s_ref._page[page]._segs, 128)) return 0;
+	return 1;
+}
+
+static void test_rotate_byte(void)
+{
+	long checks = s_checks, failures = s_failures;
+	for (int b = 0; b < 256; b++)
+		test_expect("rotate_byte", ssd1306_rotate_byte(b) == ref_rotate_byte(b), "byte %d", b);
+	test_report("rotate_byte", checks, failures);
+}
+
+// Every start offset in a word, every length up to five words, and the
+// bytes around the range must stay as they were
+static void test_buffer_kernel(const char * name, void (*kernel)(uint8_t *, size_t),
+	void (*ref)(uint8_t *, size_t))
+{
+	long checks = s_checks, failures = s_failures;
+	uint32_t words[16];
+	uint8_t * buf = (uint8_t *)words;
+	uint8_t want[sizeof(words)];
+	for (int offset = 0; offset < 8; offset++) {
+		for (int len = 0; len <= 20; len++) {
+			test_fill(buf, sizeof(words));
+			memcpy(want, buf, sizeof(words));
+			kernel(buf + 4 + offset, len);
+			ref(want + 4 + offset, len);
+			test_expect(name, !memcmp(buf, want, sizeof(words)), "offset %d len %d", offset, len);
+		}
+	}
+	test_report(name, checks, failures);
+}
+
+// The layout ssd1306_transpose8 documents, bit by bit
+static void test_transpose_ref(const uint8_t rows[8], uint8_t cols[8])
+{
+	for (int col = 0; col < 8; col++) {
+		cols[col] = 0;
+		for (int row = 0; row < 8; row++)
+			if (rows[row] & (0x80 >> col)) cols[col] |= 1 << row;
+	}
+}
+
+static void test_transpose_one(const uint8_t rows[8])
+{
+	uint8_t want[8];
+	test_transpose_ref(rows, want);
+	uint32_t hi = ((uint32_t)rows[7] << 24) | (rows[6] << 16) | (rows[5] << 8) | rows[4];
+	uint32_t lo = ((uint32_t)rows[3] << 24) | (rows[2] << 16) | (rows[1] << 8) | rows[0];
+	ssd1306_transpose8(&hi, &lo);
+	uint8_t got[8] = { hi >> 24, hi >> 16, hi >> 8, hi, lo >> 24, lo >> 16, lo >> 8, lo };
+	test_expect("transpose8", !memcmp(got, want, 8), "rows %02x%02x%02x%02x%02x%02x%02x%02x",
+		rows[0], rows[1], rows[2], rows[3], rows[4], rows[5], rows[6], rows[7]);
+}
+
+static void test_rotate_image_one(const uint8_t image[8], bool flip)
+{
+	uint8_t got[8], want[8];
+	memcpy(got, image, 8);
+	memcpy(want, image, 8);
+	ssd1306_rotate_image(got, flip);
+	ref_rotate_image(want, flip);
+	test_expect("rotate_image", !memcmp(got, want, 8), "image %02x%02x%02x%02x%02x%02x%02x%02x flip %d",
+		image[0], image[1], image[2], image[3], image[4], image[5], image[6], image[7], flip);
+}
+
+static void test_blocks(void)
+{
+	long checks = s_checks, failures = s_failures;
+	uint8_t block[8];
+	// Zero and the 64 single-bit blocks span every block over GF(2)
+	memset(block, 0, 8);
+	test_transpose_one(block);
+	test_rotate_image_one(block, false);
+	test_rotate_image_one(block, true);
+	for (int bit = 0; bit < 64; bit++) {
+		memset(block, 0, 8);
+		block[bit / 8] = 1 << (bit % 8);
+		test_transpose_one(block);
+		test_rotate_image_one(block, false);
+		test_rotate_image_one(block, true);
+	}
+	for (int i = 0; i < 100000; i++) {
+		test_fill(block, 8);
+		test_transpose_one(block);
+		test_rotate_image_one(block, i & 1);
+	}
+	test_report("transpose8_rotate_image", checks, failures);
+}
+
+// One row up / down with wrap is what the old SCROLL_UP / SCROLL_DOWN did
+static void test_scroll_rows(int height, bool flip)
+{
+	long checks = s_checks, failures = s_failures;
+	static const int spans[][2] = { { 0, 127 }, { 0, 0 }, { 5, 9 }, { 3, 64 }, { 100, 127 }, { 40, 200 } };
+	test_init_dev(&s_dev, height, flip);
+	test_init_dev(&s_ref, height, flip);
+	for (size_t i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+		int start = spans[i][0], end = spans[i][1];
+		test_random_frame();
+		ssd1306_wrap_arround(&s_dev, SCROLL_UP, start, end, -1);
+		ref_scroll_up(&s_ref, start, end);
+		test_expect("scroll_up", test_same_frame(), "segs %d-%d height %d", start, end, height);
+		test_random_frame();
+		ssd1306_wrap_arround(&s_dev, SCROLL_DOWN, start, end, -1);
+		ref_scroll_down(&s_ref, start, end);
+		test_expect("scroll_down", test_same_frame(), "segs %d-%d height %d", start, end, height);
+	}
+	char name[48];
+	snprintf(name, sizeof(name), "scroll_rows_%d%s", height, flip ? "_flip" : "");
+	test_report(name, checks, failures);
+}
+
+// Every shift from more than a screen up to more than a screen down
+static void test_vertical_shift(int height, bool flip, bool wrap)
+{
+	long checks = s_checks, failures = s_failures;
+	static const int spans[][2] = { { 0, 127 }, { 1, 6 }, { 7, 7 }, { 13, 99 } };
+	test_init_dev(&s_dev, height, flip);
+	test_init_dev(&s_ref, height, flip);
+	for (int lines = -height - 9; lines <= height + 9; lines++) {
+		for (size_t i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+			int start = spans[i][0], end = spans[i][1];
+			test_random_frame();
+			ssd1306_vertical_shift(&s_dev, start, end, lines, wrap);
+			ref_vertical_shift(&s_ref, start, end, lines, wrap);
+			test_expect("vertical_shift", test_same_frame(), "lines %d segs %d-%d", lines, start, end);
+		}
+	}
+	char name[48];
+	snprintf(name, sizeof(name), "vertical_shift_%d%s%s", height, flip ? "_flip" : "", wrap ? "_wrap" : "");
+	test_report(name, checks, failures);
+}
+
+static int test_coord(int lo, int hi)
+{
+	return lo + (int)(test_rand() % (uint32_t)(hi - lo + 1));
+}
+
+// Random shapes, partly off the panel, set and cleared: the span based
+// routines must touch exactly the pixels of the per-pixel ones
+static void test_shapes(bool flip)
+{
+	long checks = s_checks, failures = s_failures;
+	test_init_dev(&s_dev, 64, flip);
+	test_init_dev(&s_ref, 64, flip);
+	for (int i = 0; i < 20000; i++) {
+		int x0 = test_coord(-20, 147), y0 = test_coord(-20, 83);
+		int x1 = test_coord(-20, 147), y1 = test_coord(-20, 83);
+		int r = test_coord(0, 40);
+		unsigned int opt = test_coord(0, 15);
+		bool invert = i & 1;
+		test_random_frame();
+		switch (i % 4) {
+		case 0:
+			_ssd1306_line(&s_dev, x0, y0, x1, y1, invert);
+			ref_line(&s_ref, x0, y0, x1, y1, invert);
+			test_expect("line", test_same_frame(), "%d,%d-%d,%d", x0, y0, x1, y1);
+			break;
+		case 1:
+			_ssd1306_circle(&s_dev, x0, y0, r, opt, invert);
+			ref_circle(&s_ref, x0, y0, r, opt, invert);
+			test_expect("circle", test_same_frame(), "%d,%d r %d opt %u", x0, y0, r, opt);
+			break;
+		case 2:
+			_ssd1306_disc(&s_dev, x0, y0, r, opt, invert);
+			ref_disc(&s_ref, x0, y0, r, opt, invert);
+			test_expect("disc", test_same_frame(), "%d,%d r %d opt %u", x0, y0, r, opt);
+			break;
+		default:
+			_ssd1306_fill_rect(&s_dev, x0, y0, x1 - 60, y1 - 30, invert);
+			ref_fill_rect(&s_ref, x0, y0, x1 - 60, y1 - 30, invert);
+			test_expect("fill_rect", test_same_frame(), "%d,%d %dx%d", x0, y0, x1 - 60, y1 - 30);
+			break;
+		}
+	}
+	test_report(flip ? "shapes_flip" : "shapes", checks, failures);
+}
+
+int main(void)
+{
+	host_panel = NULL;
+	printf("test,checks,failures\n");
+	test_rotate_byte();
+	test_buffer_kernel("invert", ssd1306_invert, ref_invert);
+	test_buffer_kernel("flip", ssd1306_flip, ref_flip);
+	test_blocks();
+	for (int flip = 0; flip < 2; flip++) {
+		test_shapes(flip);
+		test_scroll_rows(64, flip);
+		test_scroll_rows(32, flip);
+		for (int wrap = 0; wrap < 2; wrap++) {
+			test_vertical_shift(64, flip, wrap);
+			test_vertical_shift(32, flip, wrap);
+		}
+	}
+	return s_failures != 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * num_format against snprintf: time per call and a check that both print
+ * the same text for the values the UI shows.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -std=gnu11 -Isrc src/num_format.c tools/bench/num_format_bench.c -o num_format_bench
+ *   ./num_format_bench                     # exit code 1 on a mismatch
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "num_format.h"
+
+#define BENCH_ROUNDS 200000
+#define BENCH_VALUES 64
+
+static volatile uint32_t s_sink; // Keeps the results alive
+
+static int64_t bench_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Values in the range of the accel (g) and gyro (dps) screens */
+static void bench_values(float * values)
+{
+	uint32_t seed = 12345;
+	for (int i = 0; i < BENCH_VALUES; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		float range = (i & 1) ? 2000.0f : 16.0f;
+		values[i] = ((int32_t)(seed >> 8) - (1 << 23)) * (range / (1 << 23));
+	}
+}
+
+int main(void)
+{
+	float values[BENCH_VALUES];
+	char a[32], b[32];
+	bench_values(values);
+
+	// Same text as printf, over the bench values and a sweep of the
+	// millesimal grid where rounding ties live
+	int mismatches = 0;
+	for (int i = 0; i < BENCH_VALUES + 40000; i++) {
+		float v = (i < BENCH_VALUES) ? values[i] : (i - BENCH_VALUES - 20000) * 0.0005f;
+		snprintf(a, sizeof(a), "%.3f", v);
+		fmt_float(b, sizeof(b), v, 3, 0);
+		if (strcmp(a, b) != 0 && mismatches++ == 0) printf("first mismatch: %s / %s\n", a, b);
+	}
+	for (int i = -1000; i <= 1000; i += 7) {
+		snprintf(a, sizeof(a), "%05d", i * 37);
+		fmt_int(b, sizeof(b), i * 37, 5, '0');
+		if (strcmp(a, b) != 0 && mismatches++ == 0) printf("first mismatch: %s / %s\n", a, b);
+	}
+	printf("mismatches against snprintf: %d\n", mismatches);
+
+	int64_t t0 = bench_now_us();
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		snprintf(a, sizeof(a), "%.3f", values[r % BENCH_VALUES]);
+		s_sink += a[1];
+	}
+	int64_t t1 = bench_now_us();
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		fmt_float(a, sizeof(a), values[r % BENCH_VALUES], 3, 0);
+		s_sink += a[1];
+	}
+	int64_t t2 = bench_now_us();
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		snprintf(a, sizeof(a), "%02d:%02d:%02d", r % 24, r % 60, (r >> 2) % 60);
+		s_sink += a[1];
+	}
+	int64_t t3 = bench_now_us();
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		fmt_clock(a, sizeof(a), r % 24, r % 60, (r >> 2) % 60);
+		s_sink += a[1];
+	}
+	int64_t t4 = bench_now_us();
+
+	printf("%%.3f      snprintf %6lld ns  fmt_float %6lld ns\n",
+		(long long)((t1 - t0) * 1000 / BENCH_ROUNDS), (long long)((t2 - t1) * 1000 / BENCH_ROUNDS));
+	printf("%%02d:..   snprintf %6lld ns  fmt_clock %6lld ns\n",
+		(long long)((t3 - t2) * 1000 / BENCH_ROUNDS), (long long)((t4 - t3) * 1000 / BENCH_ROUNDS));
+	return mismatches != 0;
+}
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Decodes the metrics dump that metrics_log() prints (src/metrics.h).
+
+Paste the hex of the METRICS log line, or pipe the serial log through:
+
+    python3 tools/metrics_decode.py 4d545243...
+    idf.py monitor | python3 tools/metrics_decode.py
+"""
+import re
+import sys
+
+TYPES = {1: "counter", 2: "gauge", 3: "histogram"}
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def u8(self):
+        self.pos += 1
+        return self.data[self.pos - 1]
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            byte = self.u8()
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    def bytes(self, n):
+        self.pos += n
+        return self.data[self.pos - n:self.pos]
+
+
+def decode(data):
+    r = Reader(data)
+    if r.bytes(4) != b"MTRC":
+        raise ValueError("not a metrics dump")
+    version = r.u8()
+    if version != 1:
+        raise ValueError("unknown version %d" % version)
+    count = r.varint()
+    print("uptime %.3f s, %d metrics" % (r.varint() / 1000, count))
+    for _ in range(count):
+        kind = TYPES.get(r.u8(), "?")
+        name = r.bytes(r.u8()).decode()
+        if kind == "counter":
+            print("%-24s %12d" % (name, r.varint()))
+        elif kind == "gauge":
+            z = r.varint()
+            print("%-24s %12d" % (name, (z >> 1) ^ -(z & 1)))
+        elif kind == "histogram":
+            total = r.varint()
+            buckets = [r.varint() for _ in range(r.u8())]
+            n = sum(buckets)
+            mean = total / n if n else 0
+            print("%-24s %12d  mean %.0f" % (name, n, mean))
+            for i, c in enumerate(buckets):
+                if c:
+                    low = 0 if i == 0 else 1 << (i - 1)
+                    high = "" if i == len(buckets) - 1 else (1 << i) - 1 if i else 0
+                    print("%24s %12d  %d..%s" % ("", c, low, high))
+        else:
+            raise ValueError("unknown metric type in %s" % name)
+
+
+def main():
+    lines = sys.argv[1:] or sys.stdin
+    for line in lines:
+        match = re.search(r"(4d545243[0-9a-f]*)", line)
+        if match:
+            decode(bytes.fromhex(match.group(1)))
+
+
+if __name__ == "__main__":
+    main()
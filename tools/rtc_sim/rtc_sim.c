@@ -0,0 +1,383 @@
+/*
+ * Host simulation of the RTC task (src/RTC_manager.c). The DS3231 and the
+ * system clock are modelled with their own frequency errors, adjtime()
+ * slews like ESP-IDF's (1/64 of the elapsed time) and FreeRTOS delays end
+ * on the 100 Hz tick. Each scenario runs a simulated day, once with the
+ * 1 Hz SQW interrupt and once polling the seconds register, and checks:
+ *
+ *   - after the boot time is set, the system clock is stepped exactly as
+ *     often as expected and never goes back otherwise,
+ *   - an RTC that lost its time is written once,
+ *   - with SQW, clock_second() gets the RTC's second, even while the
+ *     system clock is off by more than half a second,
+ *   - after the first hour, and right after an RTC write, the system clock
+ *     is within SIM_MAX_ERR_US of the RTC.
+ *
+ * rtc_write_time() is also started at every millisecond of a second: the
+ * RTC has to come out within SIM_WRITE_MAX_US of the system clock, and
+ * with the system clock not set it has to fail without waiting.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -std=gnu11 -Itools/ssd1306_emu/host -Isrc tools/rtc_sim/rtc_sim.c -lm -o rtc_sim
+ *   ./rtc_sim                              # exit code 1 when a check fails
+ */
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+// The RTC code reads, sets and slews the system clock through these
+static int sim_gettimeofday(struct timeval * tv, void * tz);
+static int sim_settimeofday(const struct timeval * tv, void * tz);
+static int sim_adjtime(const struct timeval * delta, struct timeval * olddelta);
+#define gettimeofday sim_gettimeofday
+#define settimeofday sim_settimeofday
+#define adjtime sim_adjtime
+
+#include "RTC_manager.c"
+
+#define SIM_EPOCH_S         1760000000LL    // Times below are in us from here
+#define SIM_DAY_US          86400e6
+#define SIM_WARMUP_US       3600e6          // Errors count from here on
+#define SIM_MAX_ERR_US      2000.0
+#define SIM_WRITE_MAX_US    2000.0
+#define SIM_TICK_US         (portTICK_PERIOD_MS * 1000.0)
+#define SIM_I2C_US          100.0           // Per transfer, plus per byte:
+#define SIM_I2C_BYTE_US     25.0            // 9 bits at 400 kHz
+#define SIM_ISR_US          20.0            // Edge to the task running
+
+typedef struct {
+	const char * name;
+	double sys_offset_us;   // Added to the system clock once booted
+	double sys_ppm;         // Frequency error of the system clock
+	double sys_ppm_later;   // and after half a day
+	double rtc_ppm;
+	bool rtc_lost;          // OSF set, the RTC holds an old time
+	int steps;              // Expected steps of the system clock
+	int writes;             // Expected writes of the RTC time
+	double sqw_max_err_us;  // Tighter bound with SQW, 0 for SIM_MAX_ERR_US
+} sim_scenario_t;
+
+static const sim_scenario_t s_scenarios[] = {
+	{ "in_sync", 0, 0, 0, 0, false, 0, 0, 0 },
+	{ "step_5s", 5e6, -45, -45, 1, false, 1, 0, 0 },
+	{ "drift_30_then_10ppm", -200000, 30, 10, 0, false, 0, 0, 0 },
+	{ "drift_0.6ppm", 0, 0.6, 0.6, 0, false, 0, 0, 20 }, // Below 1 us per frequency step
+	{ "rtc_lost", 374321, 10, 10, -2, true, 0, 1, 0 },
+};
+
+static struct {
+	const sim_scenario_t * scenario;
+	double t;               // True time
+	double sys;             // System clock, slewed and set by the RTC code
+	double timer;           // esp_timer, same crystal, never touched
+	double rtc;
+	double pending;         // adjtime() slew still to apply
+	double last_read;       // Last system time handed out
+	double end;
+	bool sqw;               // SQW interrupt available
+	gpio_isr_t isr;
+	bool notified;
+	uint8_t control;        // DS3231 control register
+	bool osf;
+	bool booted;            // Past the boot time sync_logic() sets
+	int steps;
+	int writes;
+	int backwards;
+	int bad_seconds;
+	double max_err;
+	jmp_buf done;
+} s_sim;
+
+// Rate of the system crystal, which also runs esp_timer and the tick
+static double sim_sys_rate(void)
+{
+	const sim_scenario_t * sc = s_sim.scenario;
+	return 1 + ((s_sim.t < SIM_DAY_US / 2) ? sc->sys_ppm : sc->sys_ppm_later) * 1e-6;
+}
+
+static void sim_run(double dt)
+{
+	double rate = sim_sys_rate();
+	double slew = fmin(dt / 64, fabs(s_sim.pending));
+	if (s_sim.pending < 0) slew = -slew;
+	s_sim.pending -= slew;
+	s_sim.t += dt;
+	s_sim.sys += dt * rate + slew;
+	s_sim.timer += dt * rate;
+	s_sim.rtc += dt * (1 + s_sim.scenario->rtc_ppm * 1e-6);
+	if (s_sim.t > SIM_WARMUP_US) s_sim.max_err = fmax(s_sim.max_err, fabs(s_sim.sys - s_sim.rtc));
+}
+
+// True time to the next RTC second, where SQW falls
+static double sim_to_edge(void)
+{
+	double next = (floor(s_sim.rtc / 1e6) + 1) * 1e6;
+	return (next - s_sim.rtc) / (1 + s_sim.scenario->rtc_ppm * 1e-6);
+}
+
+static bool sim_sqw_on(void)
+{
+	return s_sim.isr && !(s_sim.control & (RTC_CONTROL_INTCN | RTC_CONTROL_RS));
+}
+
+// Let dt of true time pass, taking the SQW interrupts on the way
+static void sim_advance(double dt)
+{
+	while (dt > 0) {
+		double edge = sim_sqw_on() ? sim_to_edge() : INFINITY;
+		if (edge > dt) {
+			sim_run(dt);
+			break;
+		}
+		sim_run(edge);
+		dt -= edge;
+		s_sim.isr(NULL);
+	}
+	if (s_sim.t > s_sim.end) longjmp(s_sim.done, 1);
+}
+
+// True time until the tick 'ticks' ticks from now; a delay ends on a tick,
+// so it is up to one tick short of ticks * 10 ms
+static double sim_to_tick(TickType_t ticks)
+{
+	double next = (floor(s_sim.timer / SIM_TICK_US) + ticks) * SIM_TICK_US;
+	return (next - s_sim.timer) / sim_sys_rate();
+}
+
+/* System clock */
+
+static int sim_gettimeofday(struct timeval * tv, void * tz)
+{
+	sim_advance(1);
+	if (s_sim.sys < s_sim.last_read) s_sim.backwards++;
+	s_sim.last_read = s_sim.sys;
+	int64_t us = (int64_t)floor(s_sim.sys);
+	tv->tv_sec = SIM_EPOCH_S + us / 1000000;
+	tv->tv_usec = us % 1000000;
+	return 0;
+}
+
+static int sim_settimeofday(const struct timeval * tv, void * tz)
+{
+	if (s_sim.booted) s_sim.steps++;
+	s_sim.sys = (double)(tv->tv_sec - SIM_EPOCH_S) * 1e6 + tv->tv_usec;
+	s_sim.last_read = s_sim.sys;
+	return 0;
+}
+
+static int sim_adjtime(const struct timeval * delta, struct timeval * olddelta)
+{
+	if (olddelta) {
+		int64_t us = (int64_t)s_sim.pending;
+		olddelta->tv_sec = us / 1000000;
+		olddelta->tv_usec = us % 1000000;
+	}
+	if (delta) s_sim.pending = (double)delta->tv_sec * 1e6 + delta->tv_usec;
+	return 0;
+}
+
+int64_t esp_timer_get_time(void)
+{
+	return (int64_t)s_sim.timer;
+}
+
+/* DS3231 */
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t dev, const uint8_t * write_buffer, size_t write_size, uint8_t * read_buffer, size_t read_size, int timeout_ms)
+{
+	sim_advance(SIM_I2C_US + SIM_I2C_BYTE_US * write_size);
+	// The registers are latched at the start of the read
+	time_t now = SIM_EPOCH_S + (time_t)floor(s_sim.rtc / 1e6);
+	struct tm tm;
+	gmtime_r(&now, &tm);
+	uint8_t regs[RTC_REG_STATUS + 1] = {
+		dec2bcd(tm.tm_sec), dec2bcd(tm.tm_min), dec2bcd(tm.tm_hour), dec2bcd(tm.tm_wday + 1),
+		dec2bcd(tm.tm_mday), dec2bcd(tm.tm_mon + 1), dec2bcd(tm.tm_year - 100),
+	};
+	regs[RTC_REG_CONTROL] = s_sim.control;
+	regs[RTC_REG_STATUS] = s_sim.osf ? RTC_STATUS_OSF : 0;
+	for (size_t i = 0; i < read_size; i++) read_buffer[i] = regs[(write_buffer[0] + i) % sizeof(regs)];
+	sim_advance(SIM_I2C_BYTE_US * read_size);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t * write_buffer, size_t write_size, int timeout_ms)
+{
+	sim_advance(SIM_I2C_US + SIM_I2C_BYTE_US * write_size);
+	if (write_buffer[0] == RTC_REG_SECONDS && write_size >= 8) {
+		// Writing the seconds restarts the countdown: the second starts now
+		struct tm tm = {
+			.tm_sec = bcd2dec(write_buffer[1]), .tm_min = bcd2dec(write_buffer[2]),
+			.tm_hour = bcd2dec(write_buffer[3]), .tm_mday = bcd2dec(write_buffer[5]),
+			.tm_mon = bcd2dec(write_buffer[6]) - 1, .tm_year = bcd2dec(write_buffer[7]) + 100,
+		};
+		s_sim.rtc = (double)(timegm(&tm) - SIM_EPOCH_S) * 1e6;
+		s_sim.writes++;
+		// The write has to hold as is, not be slewed to for a minute
+		s_sim.max_err = fmax(s_sim.max_err, fabs(s_sim.rtc - s_sim.sys));
+	} else if (write_buffer[0] == RTC_REG_CONTROL) {
+		s_sim.control = write_buffer[1];
+	} else if (write_buffer[0] == RTC_REG_STATUS) {
+		s_sim.osf = write_buffer[1] & RTC_STATUS_OSF;
+	}
+	return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t * config)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void * arg)
+{
+	if (!s_sim.sqw) return ESP_FAIL;
+	s_sim.isr = handler;
+	return ESP_OK;
+}
+
+/* FreeRTOS */
+
+void vTaskDelay(TickType_t ticks)
+{
+	sim_advance(ticks ? sim_to_tick(ticks) : 1);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(s_sim.timer / SIM_TICK_US);
+}
+
+BaseType_t xTaskCreate(void (*task)(void *), const char * name, uint32_t stack, void * arg, UBaseType_t priority, TaskHandle_t * handle)
+{
+	return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t * woken)
+{
+	s_sim.notified = true;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+	double timeout = sim_to_tick(ticks);
+	while (!s_sim.notified && timeout > 0) {
+		double edge = sim_sqw_on() ? sim_to_edge() : INFINITY;
+		double dt = fmin(timeout, edge);
+		sim_advance(dt);
+		timeout -= dt;
+	}
+	if (!s_sim.notified) return 0;
+	s_sim.notified = false;
+	sim_advance(SIM_ISR_US);
+	return 1;
+}
+
+/* What the RTC task calls besides */
+
+const char * esp_err_to_name(esp_err_t code)
+{
+	return (code == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+// Past the boot sync: put the system clock off as the scenario says
+void clock_init(void)
+{
+	s_sim.booted = true;
+	s_sim.sys += s_sim.scenario->sys_offset_us;
+	s_sim.last_read = s_sim.sys;
+}
+// With SQW, each second has to carry the RTC's, whatever the system says
+void clock_second(time_t now)
+{
+	if (s_sim.sqw && !s_sim.osf && now != SIM_EPOCH_S + (time_t)floor(s_sim.rtc / 1e6)) s_sim.bad_seconds++;
+}
+
+void clock_resync(void) { }
+void diag_loop_tick(diag_loop_t loop) { }
+void boot_mark(boot_stage_t stage) { }
+void metrics_register(metric_t * metric) { }
+
+/* Runs */
+
+static void sim_reset(const sim_scenario_t * scenario, bool sqw)
+{
+	memset(&s_sim, 0, sizeof(s_sim));
+	s_sim.scenario = scenario;
+	s_sim.sqw = sqw;
+	s_sim.end = INFINITY;
+	s_sim.control = RTC_CONTROL_INTCN;
+	s_sim.rtc = 0;
+	s_sim.timer = 5e6; // Boot took a while
+	if (scenario->rtc_lost) {
+		s_sim.osf = true;
+		s_sim.rtc = -(double)(SIM_EPOCH_S - 946684800) * 1e6; // 2000-01-01, the DS3231 reset time
+	}
+	s_rtc_task = (TaskHandle_t)1;
+	s_sqw_timer_us = 0;
+	s_anchor_timer_us = 0;
+	s_anchor_second = 0;
+}
+
+static int sim_scenario(const sim_scenario_t * scenario, bool sqw)
+{
+	sim_reset(scenario, sqw);
+	s_sim.end = SIM_DAY_US;
+	if (!setjmp(s_sim.done)) rtc_task((void *)1);
+
+	bool ok = s_sim.steps == scenario->steps && s_sim.writes == scenario->writes
+		&& s_sim.backwards == 0 && s_sim.bad_seconds == 0
+		&& s_sim.max_err < ((sqw && scenario->sqw_max_err_us) ? scenario->sqw_max_err_us : SIM_MAX_ERR_US);
+	printf("%s,%s,%d,%d,%d,%d,%.0f,%s\n", scenario->name, sqw ? "sqw" : "poll", s_sim.steps,
+		s_sim.writes, s_sim.backwards, s_sim.bad_seconds, s_sim.max_err, ok ? "ok" : "FAIL");
+	return !ok;
+}
+
+// rtc_write_time() from every millisecond of a second, on a system clock
+// 20 ppm fast; afterwards the RTC second has to start with the system one
+static int sim_write_time(void)
+{
+	static const sim_scenario_t scenario = { "write_time", 0, 20, 20, 0, true, 0, 1, 0 };
+	double worst = 0;
+	for (int ms = 0; ms < 1000; ms++) {
+		sim_reset(&scenario, false);
+		s_sim.sys = 1000e6 + ms * 1000.0 + 37;
+		s_sim.timer += ms * 1000.0 + 3170;
+		rtc_write_time((i2c_master_dev_handle_t)1);
+		worst = fmax(worst, fabs(s_sim.rtc - s_sim.sys));
+	}
+	bool ok = worst < SIM_WRITE_MAX_US;
+	printf("write_time,,,1000,,,%.0f,%s\n", worst, ok ? "ok" : "FAIL");
+	return !ok;
+}
+
+// An unset system clock (2000-01-01) must fail at once, not after the
+// wait for the next second
+static int sim_write_time_unset(void)
+{
+	static const sim_scenario_t scenario = { "write_time_unset", 0, 0, 0, 0, true, 0, 0, 0 };
+	sim_reset(&scenario, false);
+	s_sim.sys = -(double)(SIM_EPOCH_S - 946684800) * 1e6 + 500000;
+	esp_err_t err = rtc_write_time((i2c_master_dev_handle_t)1);
+	bool ok = err == ESP_ERR_INVALID_STATE && s_sim.writes == 0 && s_sim.t < 1000;
+	printf("write_time_unset,,,%d,,,,%s\n", s_sim.writes, ok ? "ok" : "FAIL");
+	return !ok;
+}
+
+int main(void)
+{
+	setenv("TZ", "UTC0", 1);
+	tzset();
+	int failed = 0;
+	printf("scenario,edges,steps,rtc_writes,backwards,bad_seconds,max_err_us,result\n");
+	failed |= sim_write_time();
+	failed |= sim_write_time_unset();
+	for (size_t i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+		failed |= sim_scenario(&s_scenarios[i], true);
+		failed |= sim_scenario(&s_scenarios[i], false);
+	}
+	return failed;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef int i2c_port_t;
+#define I2C_NUM_0 0
+#define I2C_NUM_1 1
+typedef struct i2c_master_bus_t * i2c_master_bus_handle_t;
+typedef struct i2c_master_dev_t * i2c_master_dev_handle_t;
+typedef struct {
+	uint8_t * write_buffer;
+	size_t buffer_size;
+} i2c_master_transmit_multi_buffer_info_t;
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t * write_buffer, size_t write_size, int timeout_ms);
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t dev, const uint8_t * write_buffer, size_t write_size, uint8_t * read_buffer, size_t read_size, int timeout_ms);
+esp_err_t i2c_master_multi_buffer_transmit(i2c_master_dev_handle_t dev, i2c_master_transmit_multi_buffer_info_t * buffers, size_t count, int timeout_ms);
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_idf_version.h"
+
+typedef int spi_host_device_t;
+#define SPI2_HOST 1
+#define SPI3_HOST 2
+#define SPI_DMA_CH_AUTO 3
+#define SPI_TRANS_USE_TXDATA (1 << 3)
+
+typedef struct spi_device_t * spi_device_handle_t;
+typedef struct spi_transaction_t {
+	uint32_t flags;
+	size_t length; // Bits
+	void * user;
+	union {
+		const void * tx_buffer;
+		uint8_t tx_data[4];
+	};
+} spi_transaction_t;
+typedef void (*transaction_cb_t)(spi_transaction_t * trans);
+typedef struct {
+	int clock_speed_hz;
+	int spics_io_num;
+	int queue_size;
+	transaction_cb_t pre_cb;
+} spi_device_interface_config_t;
+typedef struct {
+	int mosi_io_num;
+	int miso_io_num;
+	int sclk_io_num;
+	int quadwp_io_num;
+	int quadhd_io_num;
+	int max_transfer_sz;
+	uint32_t flags;
+} spi_bus_config_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t * config, int dma);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t * config, spi_device_handle_t * handle);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t * trans);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t * trans, uint32_t ticks);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t ** trans, uint32_t ticks);
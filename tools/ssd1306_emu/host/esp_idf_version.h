@@ -0,0 +1,6 @@
+#pragma once
+
+// The version the firmware is built with, selects the new I2C driver
+// and multi-buffer transmit
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(5, 5, 0)
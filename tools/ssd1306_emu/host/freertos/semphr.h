@@ -0,0 +1,10 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+// Single threaded host: every take succeeds
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void) { return (SemaphoreHandle_t)1; }
+static inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) { return (SemaphoreHandle_t)1; }
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) { return pdTRUE; }
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { return pdTRUE; }
+static inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks) { return pdTRUE; }
+static inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) { return pdTRUE; }
@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/i2c_master.h"
+#include "driver/spi_master.h"
+#include "esp_timer.h"
+
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+
+// The ESP-IDF calls the library makes, delivered to host_panel. Transfers
+// complete immediately and in order, so the SPI result queue is a plain
+// ring. Time is simulated: vTaskDelay() and the esp_timer shim advance it
+// and let the panel run the frames that pass meanwhile.
+
+ssd1306_emu_t * host_panel;
+
+static int64_t s_now_us;
+static int64_t s_frame_us; // Time not yet turned into panel frames
+
+static void host_advance(int64_t us)
+{
+	s_now_us += us;
+	s_frame_us += us;
+	int64_t frame_us = 1000000 / SSD1306_FRAME_HZ;
+	int frames = s_frame_us / frame_us;
+	s_frame_us -= frames * frame_us;
+	if (host_panel && frames) ssd1306_emu_frames(host_panel, frames);
+}
+
+const char * esp_err_to_name(esp_err_t code)
+{
+	return (code == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+/* FreeRTOS */
+
+void vTaskDelay(TickType_t ticks)
+{
+	host_advance((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return s_now_us / (portTICK_PERIOD_MS * 1000);
+}
+
+/* esp_timer: a periodic timer fires until it stops itself (fades do) or
+   for at most a minute of simulated time */
+
+struct esp_timer {
+	esp_timer_create_args_t args;
+	bool active;
+};
+
+int64_t esp_timer_get_time(void)
+{
+	return s_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t * args, esp_timer_handle_t * timer)
+{
+	static struct esp_timer timers[4];
+	static int count;
+	if (count == 4) return ESP_FAIL;
+	timers[count].args = *args;
+	*timer = &timers[count++];
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+	timer->active = true;
+	for (uint64_t t = 0; timer->active && t < 60000000; t += period_us) {
+		host_advance(period_us);
+		timer->args.callback(timer->args.arg);
+	}
+	timer->active = false;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+	timer->active = false;
+	return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+	return timer->active;
+}
+
+/* GPIO: only the D/C# level matters, the SPI pre-transfer callback sets it */
+
+static int s_dc_level;
+
+esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+	s_dc_level = level;
+	return ESP_OK;
+}
+
+/* I2C */
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t * write_buffer, size_t write_size, int timeout_ms)
+{
+	if (host_panel) ssd1306_emu_i2c(host_panel, write_buffer, write_size);
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_multi_buffer_transmit(i2c_master_dev_handle_t dev, i2c_master_transmit_multi_buffer_info_t * buffers, size_t count, int timeout_ms)
+{
+	if (host_panel == NULL) return ESP_OK;
+	ssd1306_emu_i2c_begin(host_panel);
+	for (size_t i = 0; i < count; i++) {
+		ssd1306_emu_i2c_write(host_panel, buffers[i].write_buffer, buffers[i].buffer_size);
+	}
+	ssd1306_emu_i2c_end(host_panel);
+	return ESP_OK;
+}
+
+/* SPI */
+
+static transaction_cb_t s_pre_cb;
+static spi_transaction_t * s_results[64];
+static int s_result_head;
+static int s_result_count;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t * config, int dma)
+{
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t * config, spi_device_handle_t * handle)
+{
+	s_pre_cb = config->pre_cb;
+	if (host_panel) host_panel->spi_hz = config->clock_speed_hz;
+	*handle = (spi_device_handle_t)1;
+	return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t * trans)
+{
+	if (s_pre_cb) s_pre_cb(trans);
+	const uint8_t * data = (trans->flags & SPI_TRANS_USE_TXDATA) ? trans->tx_data : trans->tx_buffer;
+	if (host_panel) ssd1306_emu_spi(host_panel, s_dc_level, data, trans->length / 8);
+	return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t * trans, uint32_t ticks)
+{
+	if (s_result_count == 64) return ESP_FAIL;
+	spi_device_transmit(handle, trans);
+	s_results[(s_result_head + s_result_count++) % 64] = trans;
+	return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t ** trans, uint32_t ticks)
+{
+	if (s_result_count == 0) return ESP_FAIL;
+	*trans = s_results[s_result_head];
+	s_result_head = (s_result_head + 1) % 64;
+	s_result_count--;
+	return ESP_OK;
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ssd1306_emu.h"
+
+// Parameter bytes that follow each command, SSD1306 datasheet rev 1.1
+// section 9 plus the 29h/2Ah/A3h scroll set
+static int ssd1306_emu_params(uint8_t cmd)
+{
+	switch (cmd) {
+	case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+	case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+		return 1;
+	case 0x21: case 0x22: case 0xA3:
+		return 2;
+	case 0x29: case 0x2A:
+		return 5;
+	case 0x26: case 0x27: case 0x2C: case 0x2D:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+// Frames per step of the 3-bit interval code of 26h/27h/29h/2Ah
+static const int ssd1306_emu_intervals[8] = { 5, 64, 128, 256, 3, 4, 25, 2 };
+
+void ssd1306_emu_reset(ssd1306_emu_t * emu)
+{
+	uint32_t i2c_hz = emu->i2c_hz ? emu->i2c_hz : 400000;
+	uint32_t spi_hz = emu->spi_hz ? emu->spi_hz : 10000000;
+	memset(emu, 0, sizeof(*emu));
+	emu->i2c_hz = i2c_hz;
+	emu->spi_hz = spi_hz;
+	emu->mode = 2;
+	emu->col_end = SSD1306_EMU_WIDTH - 1;
+	emu->page_end = 7;
+	emu->mux = 64;
+	emu->contrast = 0x7F;
+	emu->scroll_end_page = 7;
+	emu->scroll_end_col = SSD1306_EMU_WIDTH - 1;
+	emu->scroll_rows = 64;
+	emu->scroll_frames = 5;
+}
+
+// Move the picture of the scroll area one column, as 2Fh does every
+// scroll_frames frames
+static void ssd1306_emu_scroll_step(ssd1306_emu_t * emu, int dir, int start_page, int end_page, int start_col, int end_col)
+{
+	if (end_col >= SSD1306_EMU_WIDTH) end_col = SSD1306_EMU_WIDTH - 1;
+	if (start_col > end_col || end_page > 7) return;
+	int n = end_col - start_col;
+	for (int page = start_page; page <= end_page; page++) {
+		uint8_t * row = &emu->gddram[page][start_col];
+		if (dir > 0) {
+			uint8_t last = row[n];
+			memmove(row + 1, row, n);
+			row[0] = last;
+		} else {
+			uint8_t first = row[0];
+			memmove(row, row + 1, n);
+			row[n] = first;
+		}
+	}
+}
+
+static void ssd1306_emu_command(ssd1306_emu_t * emu, const uint8_t * c)
+{
+	uint8_t cmd = c[0];
+	if (cmd <= 0x0F) {
+		emu->col = (emu->col & 0xF0) | cmd;
+	} else if (cmd <= 0x1F) {
+		emu->col = (emu->col & 0x0F) | ((cmd & 0x0F) << 4);
+	} else if (cmd >= 0x40 && cmd <= 0x7F) {
+		emu->start_line = cmd & 0x3F;
+	} else if (cmd >= 0xB0 && cmd <= 0xB7) {
+		emu->page = cmd & 0x07;
+	} else if (cmd >= 0xC0 && cmd <= 0xCF) {
+		emu->com_remap = (cmd & 0x08) != 0;
+	} else {
+		switch (cmd) {
+		case 0x20:
+			emu->mode = c[1] & 0x03;
+			break;
+		case 0x21:
+			emu->col_start = emu->col = c[1] & 0x7F;
+			emu->col_end = c[2] & 0x7F;
+			break;
+		case 0x22:
+			emu->page_start = emu->page = c[1] & 0x07;
+			emu->page_end = c[2] & 0x07;
+			break;
+		case 0x26: case 0x27:
+			emu->scroll_dir = (cmd == 0x26) ? 1 : -1;
+			emu->scroll_start_page = c[2] & 0x07;
+			emu->scroll_frames = ssd1306_emu_intervals[c[3] & 0x07];
+			emu->scroll_end_page = c[4] & 0x07;
+			emu->scroll_start_col = c[5];
+			emu->scroll_end_col = c[6];
+			emu->scroll_voffset = 0;
+			break;
+		case 0x29: case 0x2A:
+			emu->scroll_dir = (cmd == 0x29) ? 1 : -1;
+			emu->scroll_start_page = c[2] & 0x07;
+			emu->scroll_frames = ssd1306_emu_intervals[c[3] & 0x07];
+			emu->scroll_end_page = c[4] & 0x07;
+			emu->scroll_start_col = 0;
+			emu->scroll_end_col = SSD1306_EMU_WIDTH - 1;
+			emu->scroll_voffset = c[5] & 0x3F;
+			break;
+		case 0x2C: case 0x2D:
+			ssd1306_emu_scroll_step(emu, (cmd == 0x2C) ? 1 : -1, c[2] & 0x07, c[4] & 0x07, c[5], c[6]);
+			break;
+		case 0x2E:
+			emu->scroll_active = false;
+			break;
+		case 0x2F:
+			emu->scroll_active = true;
+			emu->scroll_vpos = 0;
+			emu->scroll_phase = emu->scroll_frames;
+			break;
+		case 0x81:
+			emu->contrast = c[1];
+			break;
+		case 0x8D:
+			emu->charge_pump = (c[1] & 0x04) != 0;
+			break;
+		case 0xA0: case 0xA1:
+			emu->seg_remap = (cmd == 0xA1);
+			break;
+		case 0xA3:
+			emu->scroll_fixed_rows = c[1] & 0x3F;
+			emu->scroll_rows = c[2] & 0x7F;
+			break;
+		case 0xA4: case 0xA5:
+			emu->entire_on = (cmd == 0xA5);
+			break;
+		case 0xA6: case 0xA7:
+			emu->inverse = (cmd == 0xA7);
+			break;
+		case 0xA8:
+			emu->mux = (c[1] & 0x3F) + 1;
+			if (emu->mux < 16) emu->mux = 16;
+			break;
+		case 0xAE: case 0xAF:
+			emu->on = (cmd == 0xAF);
+			break;
+		case 0xD3:
+			emu->offset = c[1] & 0x3F;
+			break;
+		case 0xD5: case 0xD9: case 0xDA: case 0xDB: case 0xE3:
+			break; // Timing and drive settings, no effect on the picture
+		default:
+			emu->unknown++;
+			break;
+		}
+	}
+}
+
+static void ssd1306_emu_command_byte(ssd1306_emu_t * emu, uint8_t byte)
+{
+	emu->total.command_bytes++;
+	emu->stats.command_bytes++;
+	if (emu->cmd_len == 0) emu->cmd_need = ssd1306_emu_params(byte);
+	emu->cmd[emu->cmd_len++] = byte;
+	if (emu->cmd_len > emu->cmd_need) {
+		ssd1306_emu_command(emu, emu->cmd);
+		emu->cmd_len = 0;
+	}
+}
+
+static void ssd1306_emu_data_byte(ssd1306_emu_t * emu, uint8_t byte)
+{
+	emu->total.data_bytes++;
+	emu->stats.data_bytes++;
+	if (emu->col < SSD1306_EMU_WIDTH) emu->gddram[emu->page][emu->col] = byte;
+
+	switch (emu->mode) {
+	case 0: // Horizontal
+		if (++emu->col > emu->col_end) {
+			emu->col = emu->col_start;
+			if (++emu->page > emu->page_end) emu->page = emu->page_start;
+		}
+		break;
+	case 1: // Vertical
+		if (++emu->page > emu->page_end) {
+			emu->page = emu->page_start;
+			if (++emu->col > emu->col_end) emu->col = emu->col_start;
+		}
+		break;
+	default: // Page, the pointer wraps inside the page
+		if (++emu->col > emu->col_end) emu->col = emu->col_start;
+		break;
+	}
+}
+
+static void ssd1306_emu_count(ssd1306_emu_t * emu, uint32_t transactions, uint32_t bytes, double us)
+{
+	emu->total.transactions += transactions;
+	emu->stats.transactions += transactions;
+	emu->total.bytes += bytes;
+	emu->stats.bytes += bytes;
+	emu->total.bus_us += us;
+	emu->stats.bus_us += us;
+}
+
+void ssd1306_emu_i2c_begin(ssd1306_emu_t * emu)
+{
+	emu->in_i2c = true;
+	emu->i2c_expect_control = true;
+	// START, address byte with ACK
+	ssd1306_emu_count(emu, 1, 1, (1 + 9) * 1e6 / emu->i2c_hz);
+}
+
+void ssd1306_emu_i2c_write(ssd1306_emu_t * emu, const uint8_t * bytes, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		uint8_t byte = bytes[i];
+		if (emu->i2c_expect_control) {
+			emu->total.control_bytes++;
+			emu->stats.control_bytes++;
+			emu->i2c_single = (byte & 0x80) != 0;
+			emu->i2c_data = (byte & 0x40) != 0;
+			emu->i2c_expect_control = false;
+			continue;
+		}
+		if (emu->i2c_data) {
+			ssd1306_emu_data_byte(emu, byte);
+		} else {
+			ssd1306_emu_command_byte(emu, byte);
+		}
+		// Co = 1: a control byte follows every byte
+		if (emu->i2c_single) emu->i2c_expect_control = true;
+	}
+	ssd1306_emu_count(emu, 0, len, len * 9 * 1e6 / emu->i2c_hz);
+}
+
+void ssd1306_emu_i2c_end(ssd1306_emu_t * emu)
+{
+	emu->in_i2c = false;
+	// STOP
+	ssd1306_emu_count(emu, 0, 0, 1e6 / emu->i2c_hz);
+}
+
+void ssd1306_emu_i2c(ssd1306_emu_t * emu, const uint8_t * bytes, size_t len)
+{
+	ssd1306_emu_i2c_begin(emu);
+	ssd1306_emu_i2c_write(emu, bytes, len);
+	ssd1306_emu_i2c_end(emu);
+}
+
+void ssd1306_emu_spi(ssd1306_emu_t * emu, int dc, const uint8_t * bytes, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (dc) {
+			ssd1306_emu_data_byte(emu, bytes[i]);
+		} else {
+			ssd1306_emu_command_byte(emu, bytes[i]);
+		}
+	}
+	ssd1306_emu_count(emu, 1, len, len * 8 * 1e6 / emu->spi_hz);
+}
+
+void ssd1306_emu_frames(ssd1306_emu_t * emu, int frames)
+{
+	for (int i = 0; i < frames; i++) {
+		emu->frames++;
+		if (!emu->scroll_active || --emu->scroll_phase > 0) continue;
+		emu->scroll_phase = emu->scroll_frames;
+		ssd1306_emu_scroll_step(emu, emu->scroll_dir, emu->scroll_start_page, emu->scroll_end_page,
+			emu->scroll_start_col, emu->scroll_end_col);
+		if (emu->scroll_voffset && emu->scroll_rows > 0) {
+			emu->scroll_vpos = (emu->scroll_vpos + emu->scroll_voffset) % emu->scroll_rows;
+		}
+	}
+}
+
+void ssd1306_emu_render(const ssd1306_emu_t * emu, uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH])
+{
+	uint8_t lit = 55 + emu->contrast * 200 / 255;
+	int fixed = emu->scroll_fixed_rows;
+	int rows = emu->scroll_rows;
+	bool vscroll = emu->scroll_active && emu->scroll_voffset && rows > 0;
+
+	for (int y = 0; y < SSD1306_EMU_HEIGHT; y++) {
+		// Row of the COM scan, then the RAM row it shows
+		int com = emu->com_remap ? y : (emu->mux - 1) - y;
+		bool driven = emu->on && y < emu->mux;
+		if (vscroll && com >= fixed && com < fixed + rows) com = fixed + (com - fixed + emu->scroll_vpos) % rows;
+		int row = (com + emu->start_line + emu->offset) & 63;
+		for (int x = 0; x < SSD1306_EMU_WIDTH; x++) {
+			int col = emu->seg_remap ? x : (SSD1306_EMU_WIDTH - 1) - x;
+			bool on = (emu->gddram[row >> 3][col] >> (row & 7)) & 1;
+			if (emu->entire_on) on = true;
+			if (emu->inverse) on = !on;
+			pixels[y][x] = (driven && on) ? lit : 0;
+		}
+	}
+}
+
+int ssd1306_emu_write_pgm(const ssd1306_emu_t * emu, const char * path)
+{
+	uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH];
+	ssd1306_emu_render(emu, pixels);
+	FILE * f = fopen(path, "wb");
+	if (f == NULL) return -1;
+	fprintf(f, "P5\n%d %d\n255\n", SSD1306_EMU_WIDTH, SSD1306_EMU_HEIGHT);
+	size_t n = fwrite(pixels, 1, sizeof(pixels), f);
+	fclose(f);
+	return (n == sizeof(pixels)) ? 0 : -1;
+}
+
+int ssd1306_emu_compare_pgm(const ssd1306_emu_t * emu, const char * path)
+{
+	uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH];
+	uint8_t golden[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH];
+	int width, height, maxval;
+	FILE * f = fopen(path, "rb");
+	if (f == NULL) return -1;
+	int ok = fscanf(f, "P5 %d %d %d", &width, &height, &maxval) == 3 && fgetc(f) != EOF
+		&& width == SSD1306_EMU_WIDTH && height == SSD1306_EMU_HEIGHT
+		&& fread(golden, 1, sizeof(golden), f) == sizeof(golden);
+	fclose(f);
+	if (!ok) return -1;
+
+	ssd1306_emu_render(emu, pixels);
+	int diff = 0;
+	for (int y = 0; y < SSD1306_EMU_HEIGHT; y++) {
+		for (int x = 0; x < SSD1306_EMU_WIDTH; x++) {
+			if (pixels[y][x] != golden[y][x]) diff++;
+		}
+	}
+	return diff;
+}
+
+ssd1306_emu_stats_t ssd1306_emu_take_stats(ssd1306_emu_t * emu)
+{
+	ssd1306_emu_stats_t stats = emu->stats;
+	memset(&emu->stats, 0, sizeof(emu->stats));
+	return stats;
+}
@@ -0,0 +1,106 @@
+#ifndef SSD1306_EMU_H_
+#define SSD1306_EMU_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Host model of an SSD1306 controller: it interprets the byte stream the
+// library puts on the bus, keeps the 128x64 GDDRAM and renders what the
+// glass shows. Rendering takes A1h/C8h (the init sequences of this
+// library) as the upright module orientation.
+
+#define SSD1306_EMU_WIDTH 128
+#define SSD1306_EMU_HEIGHT 64
+
+// Bus traffic, kept for the whole run and since the last ssd1306_emu_take_stats()
+typedef struct {
+	uint32_t transactions; // I2C START..STOP sequences or SPI transfers
+	uint32_t bytes; // On the wire, I2C address bytes included
+	uint32_t control_bytes; // I2C control bytes (Co / D/C#)
+	uint32_t command_bytes; // Commands and their parameters
+	uint32_t data_bytes; // GDDRAM writes
+	double bus_us; // Wire time at the configured clock, no driver overhead
+} ssd1306_emu_stats_t;
+
+typedef struct {
+	uint8_t gddram[8][SSD1306_EMU_WIDTH];
+
+	// Address pointer and windows
+	int mode; // 20h: 0 horizontal, 1 vertical, 2 page
+	int col, page;
+	int col_start, col_end; // 21h
+	int page_start, page_end; // 22h
+
+	// Panel settings
+	int start_line; // 40h-7Fh
+	int offset; // D3h
+	int mux; // A8h, rows driven + 1
+	int contrast; // 81h
+	bool seg_remap; // A1h
+	bool com_remap; // C8h
+	bool inverse; // A7h
+	bool entire_on; // A5h
+	bool on; // AFh
+	bool charge_pump; // 8Dh 14h
+
+	// Continuous scroll (26h/27h/29h/2Ah/A3h/2Fh)
+	bool scroll_active;
+	int scroll_dir; // +1 towards higher columns, -1 towards lower
+	int scroll_start_page, scroll_end_page;
+	int scroll_start_col, scroll_end_col;
+	int scroll_frames; // Frames per step
+	int scroll_voffset; // Rows per step, 0 for horizontal only
+	int scroll_fixed_rows, scroll_rows; // A3h area
+	int scroll_vpos; // Accumulated vertical scroll
+	int scroll_phase; // Frames until the next step
+
+	// Command parser, a command may be split over transfers
+	uint8_t cmd[8];
+	int cmd_len;
+	int cmd_need;
+
+	// I2C transaction state
+	bool in_i2c;
+	bool i2c_expect_control;
+	bool i2c_single; // Co = 1: one byte, then another control byte
+	bool i2c_data; // D/C# of the bytes that follow
+
+	uint32_t i2c_hz;
+	uint32_t spi_hz;
+	uint32_t frames; // Panel frames advanced with ssd1306_emu_frames()
+	uint32_t unknown; // Commands the model does not know
+	ssd1306_emu_stats_t total;
+	ssd1306_emu_stats_t stats;
+} ssd1306_emu_t;
+
+// Power-on reset state
+void ssd1306_emu_reset(ssd1306_emu_t * emu);
+
+// One I2C write transaction, without the address byte. A transaction can
+// be fed in pieces (multi-buffer transmit) between begin and end.
+void ssd1306_emu_i2c(ssd1306_emu_t * emu, const uint8_t * bytes, size_t len);
+void ssd1306_emu_i2c_begin(ssd1306_emu_t * emu);
+void ssd1306_emu_i2c_write(ssd1306_emu_t * emu, const uint8_t * bytes, size_t len);
+void ssd1306_emu_i2c_end(ssd1306_emu_t * emu);
+
+// One SPI transfer, dc is the level of the D/C# pin
+void ssd1306_emu_spi(ssd1306_emu_t * emu, int dc, const uint8_t * bytes, size_t len);
+
+// Let the panel run for a number of frames (continuous scroll)
+void ssd1306_emu_frames(ssd1306_emu_t * emu, int frames);
+
+// What the glass shows, one grey byte per pixel, row by row.
+// Lit pixels get a level that follows the contrast setting.
+void ssd1306_emu_render(const ssd1306_emu_t * emu, uint8_t pixels[SSD1306_EMU_HEIGHT][SSD1306_EMU_WIDTH]);
+int ssd1306_emu_write_pgm(const ssd1306_emu_t * emu, const char * path);
+// Pixels that differ from a PGM written before, -1 when it cannot be read
+int ssd1306_emu_compare_pgm(const ssd1306_emu_t * emu, const char * path);
+
+// Traffic since the previous call
+ssd1306_emu_stats_t ssd1306_emu_take_stats(ssd1306_emu_t * emu);
+
+// The panel behind the host transport (host_port.c)
+extern ssd1306_emu_t * host_panel;
+
+#endif /* SSD1306_EMU_H_ */
@@ -0,0 +1,209 @@
+/*
+ * Draws a set of scenes with the ssd1306 library into the host panel model
+ * and reports the bus traffic of each, as CSV on stdout. Frames are written
+ * as PGM files, or compared against golden PGM files written before.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -std=gnu11 -Itools/ssd1306_emu/host -Itools/ssd1306_emu -Ilib/ssd1306 \
+ *      tools/ssd1306_emu/ssd1306_emu.c tools/ssd1306_emu/ssd1306_emu_scenes.c \
+ *      tools/ssd1306_emu/host_port.c lib/ssd1306/ssd1306.c lib/ssd1306/ssd1306_kernels.c \
+ *      lib/ssd1306/ssd1306_spi.c lib/ssd1306/ssd1306_fade.c -o ssd1306_emu_scenes
+ *   ./ssd1306_emu_scenes -o frames        # write frames/<scene>.pgm
+ *   ./ssd1306_emu_scenes -g frames        # compare, exit code 1 on a difference
+ *
+ * The I2C scenes go through the new driver code in ssd1306.c, set up the
+ * way src/ui_manager.c does it; the SPI scenes through ssd1306_spi.c.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+
+typedef enum { BUS_I2C, BUS_SPI } scene_bus_t;
+
+typedef struct {
+	const char * name;
+	scene_bus_t bus;
+	void (*draw)(SSD1306_t * dev);
+} scene_t;
+
+static ssd1306_emu_t s_panel;
+
+// Traffic before this call is set up, not part of the measured frame
+static void scene_measure_from_here(void)
+{
+	ssd1306_emu_take_stats(host_panel);
+}
+
+static void scene_init_i2c(SSD1306_t * dev)
+{
+	memset(dev, 0, sizeof(SSD1306_t));
+	dev->_i2c_dev_handle = (i2c_master_dev_handle_t)1;
+	dev->_address = I2C_ADDRESS;
+	ssd1306_init(dev, 128, 64);
+
+	// The handle is set up outside of the library, so is the panel
+	const uint8_t init[] = {
+		OLED_CONTROL_BYTE_CMD_STREAM,
+		OLED_CMD_DISPLAY_OFF, OLED_CMD_SET_MUX_RATIO, 0x3F, OLED_CMD_SET_DISPLAY_OFFSET, 0x00,
+		0x40, OLED_CMD_SET_SEGMENT_REMAP_1, OLED_CMD_SET_COM_SCAN_MODE,
+		OLED_CMD_SET_DISPLAY_CLK_DIV, 0x80, OLED_CMD_SET_COM_PIN_MAP, 0x12,
+		OLED_CMD_SET_CONTRAST, 0xFF, OLED_CMD_DISPLAY_RAM, OLED_CMD_SET_VCOMH_DESELCT, 0x40,
+		OLED_CMD_SET_MEMORY_ADDR_MODE, OLED_CMD_SET_PAGE_ADDR_MODE,
+		OLED_CMD_SET_CHARGE_PUMP, 0x14, OLED_CMD_DEACTIVE_SCROLL, OLED_CMD_DISPLAY_NORMAL,
+		OLED_CMD_DISPLAY_ON,
+	};
+	i2c_master_transmit(dev->_i2c_dev_handle, init, sizeof(init), -1);
+}
+
+static void scene_init_spi(SSD1306_t * dev)
+{
+	memset(dev, 0, sizeof(SSD1306_t));
+	spi_master_init(dev, 7, 6, 10, 1, -1);
+	ssd1306_init(dev, 128, 64);
+}
+
+static void draw_status(SSD1306_t * dev)
+{
+	ssd1306_display_text(dev, 0, "SSD1306 EMU", 11, false);
+	ssd1306_display_text_scaled(dev, 2, 0, "12:34", 5, 2, false);
+	ssd1306_display_text(dev, 7, "ACCEL  0.981", 12, true);
+}
+
+static void scene_text(SSD1306_t * dev)
+{
+	scene_measure_from_here();
+	ssd1306_clear_screen(dev, false);
+	draw_status(dev);
+}
+
+static void scene_text_deferred(SSD1306_t * dev)
+{
+	ssd1306_set_deferred(dev, true);
+	scene_measure_from_here();
+	ssd1306_clear_screen(dev, false);
+	draw_status(dev);
+	ssd1306_commit(dev);
+}
+
+// One digit changes between two frames
+static void scene_digit(SSD1306_t * dev)
+{
+	ssd1306_set_deferred(dev, true);
+	ssd1306_clear_screen(dev, false);
+	draw_status(dev);
+	ssd1306_commit(dev);
+	scene_measure_from_here();
+	ssd1306_display_text_scaled(dev, 2, 4 * 16, "5", 1, 2, false);
+	ssd1306_commit(dev);
+}
+
+static void scene_shapes(SSD1306_t * dev)
+{
+	ssd1306_set_deferred(dev, true);
+	scene_measure_from_here();
+	ssd1306_clear_screen(dev, false);
+	_ssd1306_round_rect(dev, 0, 0, 128, 64, 6, false);
+	_ssd1306_line(dev, 4, 60, 60, 4, false);
+	_ssd1306_circle(dev, 90, 32, 20, 0, false);
+	_ssd1306_disc(dev, 90, 32, 8, 0, false);
+	_ssd1306_fill_rect(dev, 20, 40, 30, 12, false);
+	ssd1306_draw_string(dev, 8, 8, &ssd1306_font_prop8, "AVAWA Tokyo", false);
+	ssd1306_commit(dev);
+}
+
+static void scene_viewport(SSD1306_t * dev)
+{
+	ssd1306_clear_screen(dev, false);
+	draw_status(dev);
+	scene_measure_from_here();
+	ssd1306_viewport_scroll(dev, 16);
+}
+
+// Ten steps of the controller's own horizontal scroll
+static void scene_hwscroll(SSD1306_t * dev)
+{
+	ssd1306_clear_screen(dev, false);
+	draw_status(dev);
+	scene_measure_from_here();
+	ssd1306_hardware_scroll(dev, SCROLL_RIGHT);
+	vTaskDelay(pdMS_TO_TICKS(200));
+}
+
+static void scene_fade(SSD1306_t * dev)
+{
+	ssd1306_clear_screen(dev, false);
+	draw_status(dev);
+	scene_measure_from_here();
+	ssd1306_fade(dev, 0x20, 400);
+}
+
+static const scene_t s_scenes[] = {
+	{ "text_i2c", BUS_I2C, scene_text },
+	{ "text_deferred_i2c", BUS_I2C, scene_text_deferred },
+	{ "digit_i2c", BUS_I2C, scene_digit },
+	{ "shapes_i2c", BUS_I2C, scene_shapes },
+	{ "viewport_i2c", BUS_I2C, scene_viewport },
+	{ "hwscroll_i2c", BUS_I2C, scene_hwscroll },
+	{ "fade_i2c", BUS_I2C, scene_fade },
+	{ "text_spi", BUS_SPI, scene_text },
+	{ "text_deferred_spi", BUS_SPI, scene_text_deferred },
+	{ "digit_spi", BUS_SPI, scene_digit },
+	{ "shapes_spi", BUS_SPI, scene_shapes },
+};
+
+int main(int argc, char ** argv)
+{
+	const char * out_dir = NULL;
+	const char * golden_dir = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:g:")) != -1) {
+		if (opt == 'o') out_dir = optarg;
+		else if (opt == 'g') golden_dir = optarg;
+		else {
+			fprintf(stderr, "usage: %s [-o out_dir] [-g golden_dir]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	int failed = 0;
+	host_panel = &s_panel;
+	printf("scene,transactions,bytes,control_bytes,command_bytes,data_bytes,bus_us,diff\n");
+	for (size_t i = 0; i < sizeof(s_scenes) / sizeof(s_scenes[0]); i++) {
+		const scene_t * scene = &s_scenes[i];
+		SSD1306_t dev;
+		ssd1306_emu_reset(&s_panel);
+		if (scene->bus == BUS_I2C) {
+			scene_init_i2c(&dev);
+		} else {
+			scene_init_spi(&dev);
+		}
+		scene->draw(&dev);
+		ssd1306_wait(&dev);
+		ssd1306_emu_stats_t stats = ssd1306_emu_take_stats(&s_panel);
+
+		char path[256];
+		int diff = 0;
+		if (golden_dir) {
+			snprintf(path, sizeof(path), "%s/%s.pgm", golden_dir, scene->name);
+			diff = ssd1306_emu_compare_pgm(&s_panel, path);
+			if (diff != 0) failed = 1;
+		}
+		if (out_dir) {
+			snprintf(path, sizeof(path), "%s/%s.pgm", out_dir, scene->name);
+			if (ssd1306_emu_write_pgm(&s_panel, path) != 0) {
+				fprintf(stderr, "Could not write %s\n", path);
+				failed = 1;
+			}
+		}
+		if (s_panel.unknown) fprintf(stderr, "%s: %u unknown commands\n", scene->name, s_panel.unknown);
+		printf("%s,%u,%u,%u,%u,%u,%.0f,%d\n", scene->name, stats.transactions, stats.bytes,
+			stats.control_bytes, stats.command_bytes, stats.data_bytes, stats.bus_us, diff);
+	}
+	return failed;
+}